@@ -9,9 +9,19 @@ extern "C" {
 #include <chrono>
 #include <numeric>
 #include <algorithm>
+#include <thread>
 #include "gui/window.h"
 #include "sim/view_config.h"
 #include "sim/lidar_view.h"
+#include "sim/replay_view.h"
+#include "sim/lidar_sim.h"
+#include "sim/tuner.h"
+#include "icp/trace.h"
+#include "icp/polar.h"
+#include "icp/timeline.h"
+#include "icp/scan_log.h"
+#include "icp/features.h"
+#include "icp/initial_guess.h"
 
 struct LidarScan {
     double range_max;
@@ -20,6 +30,9 @@ struct LidarScan {
     double angle_max;
     double angle_increment;
 
+    /** Units: meters, NaN where the scan file has no entry */
+    std::vector<double> ranges;
+
     /** Units: centimeters */
     std::vector<icp::Vector> points;
 };
@@ -37,6 +50,22 @@ void set_config_param(const char* var, const char* data,
     }
 }
 
+void parse_config(const char* path, conf_parse_handler_t handler,
+    void* user_data) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror("parse_config: fopen");
+        std::exit(1);
+    }
+
+    if (conf_parse_file(file, handler, user_data) != 0) {
+        perror("parse_config: conf_parse_file");
+        std::exit(1);
+    }
+
+    fclose(file);
+}
+
 void parse_lidar_scan(const char* var, const char* data, void* user_data) {
     LidarScan* scan = static_cast<LidarScan*>(user_data);
     if (strcmp(var, "range_min") == 0) {
@@ -52,35 +81,166 @@ void parse_lidar_scan(const char* var, const char* data, void* user_data) {
     } else if (strcmp(var, "angle_increment") == 0) {
         scan->angle_increment = strtod(data, NULL);
     } else if (isnumber(var[0])) {
-        long index = strtol(var, NULL, 10);
-        double angle = scan->angle_min + index * scan->angle_increment;
-        double range = strtod(data, NULL);
-        if (range >= scan->range_min && range <= scan->range_max) {
-            scan->points.push_back(icp::Vector(100 * range * std::cos(angle),
-                100 * range * std::sin(angle)));
-            // auto last = scan->points.back();
-            // std::cerr << last.x() << ',' << last.y() << '\n';
+        size_t index = strtoul(var, NULL, 10);
+        if (index >= scan->ranges.size()) {
+            scan->ranges.resize(index + 1, NAN);
         }
+        scan->ranges[index] = strtod(data, NULL);
     }
 }
 
-void parse_config(const char* path, conf_parse_handler_t handler,
-    void* user_data) {
+void load_lidar_scan(const char* path, LidarScan& scan) {
+    // The trigonometry tables are shared by every scan of the same sensor
+    static icp::PolarConverter converter(100);
+
+    icp::Timeline::Span span("parse");
+    parse_config(path, parse_lidar_scan, &scan);
+    span.next("convert");
+    converter.convert(scan.ranges.data(), scan.ranges.size(),
+        {scan.angle_min, scan.angle_increment, scan.range_min,
+            scan.range_max},
+        scan.points);
+}
+
+/** Reads a scan stored as one `x,y` point per line, in centimeters, by
+ * binning the points into the beams of the default simulated sensor. */
+void load_csv_scan(const char* path, LidarScan& scan) {
     FILE* file = fopen(path, "r");
     if (!file) {
-        perror("parse_config: fopen");
+        perror("load_csv_scan: fopen");
         std::exit(1);
     }
 
-    if (conf_parse_file(file, handler, user_data) != 0) {
-        perror("parse_config: conf_parse_file");
+    sim::LidarParams params;
+    scan.angle_min = params.angle_min;
+    scan.angle_max = params.angle_max;
+    scan.angle_increment = params.angle_increment;
+    scan.range_min = params.range_min;
+    scan.range_max = params.range_max;
+    const long beams = std::lround(
+        (scan.angle_max - scan.angle_min) / scan.angle_increment);
+    scan.ranges.assign(beams, NAN);
+
+    double x, y;
+    while (fscanf(file, " %lf , %lf", &x, &y) == 2) {
+        const double angle = std::atan2(y, x);
+        const long beam = std::lround(
+            (angle - scan.angle_min) / scan.angle_increment);
+        scan.ranges[(beam % beams + beams) % beams] = std::hypot(x, y) / 100;
+    }
+    fclose(file);
+}
+
+void pack_scan_log(const char* path) {
+    icp::ScanLogWriter writer;
+    if (!writer.open(path)) {
+        perror("pack_scan_log: icp::ScanLogWriter::open");
         std::exit(1);
     }
 
-    fclose(file);
+    // Scans without timestamps are numbered in order
+    std::string input;
+    size_t count = 0;
+    while (std::getline(std::cin, input)) {
+        if (input.empty()) {
+            continue;
+        }
+        LidarScan scan;
+        if (input.size() > 4 && input.substr(input.size() - 4) == ".csv") {
+            load_csv_scan(input.c_str(), scan);
+        } else {
+            parse_config(input.c_str(), parse_lidar_scan, &scan);
+        }
+        if (!writer.add(count, {scan.angle_min, scan.angle_increment,
+                                   scan.range_min, scan.range_max},
+                scan.ranges.data(), scan.ranges.size())) {
+            perror("pack_scan_log: icp::ScanLogWriter::add");
+            std::exit(1);
+        }
+        count++;
+    }
+
+    if (!writer.close()) {
+        perror("pack_scan_log: icp::ScanLogWriter::close");
+        std::exit(1);
+    }
+    std::cout << "Packed " << count << " scans into " << path << '\n';
+}
+
+/** Replaces the points of `scan` with its features. */
+void extract_features(LidarScan& scan) {
+    static icp::FeatureExtractor extractor;
+    static std::vector<icp::Vector> features;
+
+    icp::Timeline::Span span("features");
+    const size_t count = scan.points.size();
+    extractor.extract(scan.points, features);
+    scan.points.swap(features);
+    Log << "features: kept " << scan.points.size() << " of " << count
+        << " points\n";
+}
+
+void run_log_odometry(const char* method, const char* path,
+    const icp::ICP::Config& config, size_t burn_in, bool use_features) {
+    icp::ScanLog log;
+    if (!log.open(path)) {
+        std::cerr << "error: could not read scan log '" << path << "'\n";
+        std::exit(1);
+    }
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method, config);
+
+    constexpr double convergence_threshold = 20.0;
+
+    std::cout << "ICP SCAN LOG ODOMETRY\n";
+    std::cout << "=======================================\n";
+    std::cout << "* Method name: " << method << '\n';
+    std::cout << "* Scans: " << log.size() << '\n';
+
+    icp::PolarConverter converter(100);
+    icp::FeatureExtractor extractor;
+    std::vector<float> ranges;
+    std::vector<icp::Vector> previous, current, features;
+    icp::RBTransform relative, pose;
+    size_t iterations = 0;
+    std::chrono::duration<double> total{}, slowest{};
+    for (size_t i = 0; i < log.size(); i++) {
+        const icp::ScanView scan = log.scan(i);
+        scan.ranges(ranges);
+        converter.convert(ranges.data(), ranges.size(), scan.geometry(),
+            current);
+        if (use_features) {
+            extractor.extract(current, features);
+            current.swap(features);
+        }
+        if (i > 0) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            icp->begin(current, previous, relative);
+            iterations += icp->converge(burn_in, convergence_threshold)
+                              .iteration_count;
+            const std::chrono::duration<double> diff =
+                std::chrono::high_resolution_clock::now() - start;
+            total += diff;
+            slowest = std::max(slowest, diff);
+            relative = icp->current_transform();
+            pose = icp::RBTransform(pose.apply_to(relative.translation),
+                pose.rotation * relative.rotation);
+        }
+        previous.swap(current);
+    }
+
+    const size_t alignments = log.size() > 1 ? log.size() - 1 : 1;
+    std::cout << "* Mean iterations: " << (double)iterations / alignments
+              << '\n';
+    std::cout << "* Mean time per alignment: " << total.count() / alignments
+              << "s\n";
+    std::cout << "* Max time per alignment: " << slowest.count() << "s\n";
+    std::cout << "* Final pose: translation (" << pose.translation.x() << ", "
+              << pose.translation.y() << "), rotation "
+              << std::atan2(pose.rotation(1, 0), pose.rotation(0, 0))
+              << " rad\n";
 }
 
-void launch_gui(LidarView* view, std::string visualized = "LiDAR scans") {
+void launch_gui(View* view, std::string visualized = "LiDAR scans") {
     Window window("Scan Matching", view_config::window_width,
         view_config::window_height);
 
@@ -93,18 +253,31 @@ void launch_gui(LidarView* view, std::string visualized = "LiDAR scans") {
     std::cout << "* Press SPACE to toggle the simulation\n";
     std::cout << "* Press D to display the current transform\n";
     std::cout << "* Press I to step forward a single iteration\n";
+    std::cout << "* Press P to toggle the performance overlay (live runs)\n";
 
     window.present();
 }
 
+LidarScan from_simulation(const sim::SimulatedScan& simulated) {
+    LidarScan scan;
+    scan.range_max = simulated.range_max;
+    scan.range_min = simulated.range_min;
+    scan.angle_min = simulated.angle_min;
+    scan.angle_max = simulated.angle_max;
+    scan.angle_increment = simulated.angle_increment;
+    scan.points = simulated.points;
+    return scan;
+}
+
 void run_benchmark(const char* method, const LidarScan& source,
-    const LidarScan& destination) {
+    const LidarScan& destination, const icp::ICP::Config& config,
+    size_t burn_in, bool use_initial_guess,
+    const icp::RBTransform* truth = nullptr) {
     std::cout << "ICP ALGORITHM BENCHMARKING\n";
     std::cout << "=======================================\n";
-    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method);
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method, config);
 
     constexpr size_t N = 50;
-    constexpr size_t burn_in = 0;
     constexpr double convergence_threshold = 20.0;
 
     std::cout << "* Method name: " << method << '\n';
@@ -115,11 +288,15 @@ void run_benchmark(const char* method, const LidarScan& source,
 
     std::vector<double> final_costs;
     std::vector<size_t> iteration_counts;
+    icp::InitialGuess guess;
 
     const auto start = std::chrono::high_resolution_clock::now();
 
     for (size_t i = 0; i < N; i++) {
-        icp->begin(source.points, destination.points, icp::RBTransform());
+        icp->begin(source.points, destination.points,
+            use_initial_guess
+                ? guess.estimate(source.points, destination.points)
+                : icp::RBTransform());
         icp::ICP::ConvergenceReport result = icp->converge(burn_in,
             convergence_threshold);
         final_costs.push_back(result.final_cost);
@@ -159,6 +336,134 @@ void run_benchmark(const char* method, const LidarScan& source,
               << " (real: " << (mean_iterations - burn_in) << ")\n";
     std::cout << "* Average time per invocation: " << (diff.count() / N)
               << "s\n";
+    if (const icp::DistanceField* field = icp->matching_field()) {
+        std::cout << "* Distance field: " << field->width() << "x"
+                  << field->height() << " cells, "
+                  << field->memory_usage() / 1024 << "KiB\n";
+    }
+    const icp::ICP::MemoryUsage usage = icp->memory_usage();
+    std::cout << "* Memory: " << usage.total() / 1024 << "KiB ("
+              << usage.points / 1024 << "KiB points, "
+              << usage.matches / 1024 << "KiB matches, "
+              << usage.method / 1024 << "KiB method)\n";
+
+    if (truth) {
+        const icp::RBTransform& result = icp->current_transform();
+        const icp::Matrix error = truth->rotation.transpose()
+                                  * result.rotation;
+        std::cout << "* Translation error: "
+                  << (result.translation - truth->translation).norm()
+                  << "cm\n"
+                  << "* Rotation error: "
+                  << std::abs(std::atan2(error(1, 0), error(0, 0)))
+                  << " rad\n";
+    }
+}
+
+void run_simulated_benchmark(const char* method, size_t beams,
+    const icp::ICP::Config& config, size_t burn_in, bool use_initial_guess) {
+    sim::LidarParams params;
+    params.angle_increment = (params.angle_max - params.angle_min) / beams;
+    params.noise_stddev = 0.01;
+    params.dropout_rate = 0.02;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, 6, 1), params, 1);
+    sim::ScanPair pair = simulator.scan_pair(sim::pose(0, 0, 0),
+        sim::pose(0.2, -0.1, 0.05));
+
+    std::cout << "* Simulated beams: " << beams << '\n';
+    run_benchmark(method, from_simulation(pair.source),
+        from_simulation(pair.destination), config, burn_in,
+        use_initial_guess, &pair.truth);
+}
+
+void run_tuner(size_t samples, double max_error) {
+    sim::LidarParams params;
+    params.noise_stddev = 0.01;
+    params.dropout_rate = 0.02;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, 6, 1), params, 1);
+    sim::Tuner tuner(sim::Tuner::random_pairs(simulator, 8, 0.3, 0.15, 1));
+
+    const sim::TuningSpace space = sim::TuningSpace::defaults();
+    const std::vector<sim::TuningCandidate> candidates =
+        samples == 0 ? sim::Tuner::grid(space)
+                     : sim::Tuner::random(space, samples, 1);
+    const size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::cout << "ICP CONFIGURATION TUNING\n";
+    std::cout << "=======================================\n";
+    std::cout << "* Search: "
+              << (samples == 0 ? "grid" : "random") << '\n';
+    std::cout << "* Candidates: " << candidates.size() << '\n';
+    std::cout << "* Simulated scan pairs: 8\n";
+    std::cout << "* Threads: " << threads << '\n';
+
+    const std::vector<sim::TuningResult> results = tuner.evaluate(candidates,
+        threads);
+    if (results.empty()) {
+        return;
+    }
+
+    std::cout << "* Pareto front (latency, error, iterations, config):\n";
+    for (size_t i: sim::Tuner::pareto_front(results)) {
+        std::cout << "  " << results[i].latency * 1000 << "ms, "
+                  << results[i].error << "cm, " << results[i].iterations
+                  << ", " << results[i].candidate.description << '\n';
+    }
+    const sim::TuningResult& best =
+        results[sim::Tuner::recommend(results, max_error)];
+    std::cout << "* Recommended (fastest within " << max_error
+              << "cm): " << best.candidate.description << '\n';
+}
+
+void run_recording(const char* method, const LidarScan& source,
+    const LidarScan& destination, const icp::ICP::Config& config,
+    const char* path) {
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method, config);
+
+    constexpr size_t burn_in = 0;
+    constexpr double convergence_threshold = 20.0;
+
+    icp::IterationTrace trace(true);
+    icp->record(&trace);
+    icp->begin(source.points, destination.points, icp::RBTransform());
+    icp::ICP::ConvergenceReport result = icp->converge(burn_in,
+        convergence_threshold);
+
+    if (!trace.save(path)) {
+        perror("run_recording: IterationTrace::save");
+        std::exit(1);
+    }
+    std::cout << "* Recorded " << result.iteration_count
+              << " iterations to " << path << '\n';
+}
+
+void summarize_trace(const icp::IterationTrace& trace) {
+    std::cout << "ICP ITERATION TRACE\n";
+    std::cout << "=======================================\n";
+    std::cout << "* Source points: " << trace.source().size() << '\n';
+    std::cout << "* Destination points: " << trace.destination().size()
+              << '\n';
+    std::cout << "* Correspondences recorded: "
+              << (trace.has_matches() ? "yes" : "no") << '\n';
+    std::cout << "* Iterations: " << trace.frame_count() << '\n';
+    for (size_t i = 0; i < trace.frame_count(); i++) {
+        const icp::RBTransform& transform = trace.frame(i).transform;
+        std::cout << "  " << (i + 1) << ": from cost " << trace.frame(i).cost
+                  << " to translation (" << transform.translation.x() << ", "
+                  << transform.translation.y() << "), rotation "
+                  << std::atan2(transform.rotation(1, 0),
+                         transform.rotation(0, 0))
+                  << " rad\n";
+    }
+}
+
+/** Where the timeline is written at exit, if anywhere. */
+static const char* timeline_path;
+
+void save_timeline() {
+    if (!icp::Timeline::save(timeline_path)) {
+        perror("save_timeline: icp::Timeline::save");
+    }
 }
 
 int main(int argc, const char** argv) {
@@ -176,14 +481,43 @@ int main(int argc, const char** argv) {
     ca_synopsis("[-h|-v]");
     ca_synopsis("-S FILE -D FILE [-l]");
     ca_synopsis("-b METHOD [-l]");
+    ca_synopsis("-S FILE -D FILE --record FILE [-l]");
+    ca_synopsis("--replay FILE [-g]");
+    ca_synopsis("--sim BEAMS [-m METHOD]");
+    ca_synopsis("--pack FILE");
+    ca_synopsis("--scan-log FILE [-m METHOD]");
+    ca_synopsis("--tune SAMPLES [--tune-error CM]");
 
     bool* use_gui;
     bool* do_bench;
     bool* enable_log;
     bool* read_scan_files;
+    bool* do_record;
+    bool* do_replay;
+    bool* do_simulate;
     bool* basic_mode;  // for gbody people
+    bool* adaptive_overlap;
+    bool* use_distance_field;
+    bool* use_features;
+    bool* use_initial_guess;
+    bool* do_trace;
+    bool* do_pack;
+    bool* do_scan_log;
+    bool* do_tune;
     const char* f_src;
     const char* f_dst;
+    const char* f_record;
+    const char* f_replay;
+    const char* f_pack;
+    const char* f_scan_log;
+    const char* tune_samples;
+    const char* tune_error = "2";
+    const char* sim_beams;
+    const char* burn_in = "0";
+    const char* anderson_depth = "0";
+    const char* spatial_order = "none";
+    const char* sample_fraction = "1";
+    const char* field_cache = "";
     const char* config_file = "view.conf";
     const char* method = "vanilla";
 
@@ -197,6 +531,42 @@ int main(int argc, const char** argv) {
     assert(ca_opt('c', "config", ".FILE", &config_file,
         "selects a configuration file (default: view.conf)"));
     assert(ca_opt('m', "method", ".METHOD", &method, "selects an ICP method"));
+    assert(do_record = ca_long_opt("record", ".FILE&S", &f_record,
+               "records the iterations of one run to FILE. must pass -S/-D"));
+    assert(do_replay = ca_long_opt("replay", ".FILE", &f_replay,
+               "summarizes a recorded run, or replays it with -g"));
+    assert(do_pack = ca_long_opt("pack", ".FILE", &f_pack,
+               "packs the .conf/.csv scans listed on stdin into the log FILE"));
+    assert(do_scan_log = ca_long_opt("scan-log", ".FILE", &f_scan_log,
+               "aligns each scan in the log FILE to the previous one"));
+    assert(do_tune = ca_long_opt("tune", ".SAMPLES", &tune_samples,
+               "searches SAMPLES random configs (0 for a grid) on simulated "
+               "pairs"));
+    assert(ca_long_opt("tune-error", ".CM", &tune_error,
+        "recommends the fastest tuned config within CM of the truth "
+        "(default: 2)"));
+    assert(do_simulate = ca_long_opt("sim", ".BEAMS", &sim_beams,
+               "benchmarks on a simulated scan pair with BEAMS beams"));
+    assert(ca_long_opt("burn-in", ".N", &burn_in,
+        "benchmarks with a burn-in period of N iterations (default: 0)"));
+    assert(ca_long_opt("anderson", ".DEPTH", &anderson_depth,
+        "accelerates convergence from DEPTH previous iterates (default: 0)"));
+    assert(ca_long_opt("spatial-order", ".CURVE", &spatial_order,
+        "sorts the point clouds along a morton or hilbert curve"));
+    assert(ca_long_opt("sample-fraction", ".F", &sample_fraction,
+        "matches a growing sample starting at F of the source (default: 1)"));
+    assert(adaptive_overlap = ca_long_opt("adaptive-overlap", "", NULL,
+               "estimates the overlap rate instead of fixing it (trimmed)"));
+    assert(use_distance_field = ca_long_opt("distance-field", "", NULL,
+               "matches by lookup in a precomputed distance field"));
+    assert(ca_long_opt("field-cache", ".DIR", &field_cache,
+        "saves distance fields to DIR and loads them from there next time"));
+    assert(use_features = ca_long_opt("features", "", NULL,
+               "aligns only the corners and line samples of each scan"));
+    assert(use_initial_guess = ca_long_opt("initial-guess", "", NULL,
+               "starts from a rotation estimated by orientation histograms"));
+    assert(do_trace = ca_long_opt("trace", ".FILE", &timeline_path,
+               "writes a timeline of the run to FILE as Chrome trace JSON"));
     assert(basic_mode = ca_long_opt("basic-mode", "", NULL,
                "uses a ligher gui background"));
     assert(enable_log = ca_opt('l', "log", "", NULL, "enables debug logging"));
@@ -211,6 +581,10 @@ int main(int argc, const char** argv) {
     }
 
     Log.is_enabled = *enable_log;
+    if (*do_trace) {
+        icp::Timeline::enable();
+        std::atexit(save_timeline);
+    }
     parse_config(config_file, set_config_param, NULL);
     if (*basic_mode) {
         view_config::use_light_background = true;
@@ -226,6 +600,31 @@ int main(int argc, const char** argv) {
         std::exit(1);
     }
 
+    if (*do_tune) {
+        run_tuner(std::stoul(tune_samples), std::stod(tune_error));
+        return 0;
+    }
+
+    if (*do_pack) {
+        pack_scan_log(f_pack);
+        return 0;
+    }
+
+    if (*do_replay) {
+        icp::IterationTrace trace;
+        if (!icp::IterationTrace::load(f_replay, trace)) {
+            std::cerr << "error: could not read trace '" << f_replay << "'\n";
+            std::exit(1);
+        }
+        if (*use_gui) {
+            launch_gui(new ReplayView(trace),
+                std::string("replay of ") + std::string(f_replay));
+        } else {
+            summarize_trace(trace);
+        }
+        return 0;
+    }
+
     // std::vector<icp::Vector> a = {icp::Vector(0, 0), icp::Vector(0, 100)};
     // std::vector<icp::Vector> b = {icp::Vector(100, 0), icp::Vector(100,
     // 100)}; LidarView* view = new LidarView(a, b, method);
@@ -233,18 +632,45 @@ int main(int argc, const char** argv) {
     // launch_gui(view, "test");
     // return 0;
 
+    icp::ICP::Config config;
+    if (*adaptive_overlap) {
+        config.set("adaptive_overlap", 1);
+    }
+    config.set("anderson_depth", std::stoi(anderson_depth));
+    config.set("spatial_order", std::string(spatial_order));
+    config.set("sample_fraction", std::stod(sample_fraction));
+    if (*use_distance_field) {
+        config.set("distance_field", 1);
+        config.set("field_cache", std::string(field_cache));
+    }
+
+    if (*do_scan_log) {
+        run_log_odometry(method, f_scan_log, config, std::stoul(burn_in),
+            *use_features);
+        return 0;
+    }
+
+    if (*do_simulate) {
+        run_simulated_benchmark(method, std::stoul(sim_beams), config,
+            std::stoul(burn_in), *use_initial_guess);
+        return 0;
+    }
+
     if (*read_scan_files) {
         LidarScan source, destination;
         std::cerr << "source\n";
-        parse_config(f_src, parse_lidar_scan, &source);
+        load_lidar_scan(f_src, source);
         std::cerr << "dest\n";
-        parse_config(f_dst, parse_lidar_scan, &destination);
+        load_lidar_scan(f_dst, destination);
+        if (*use_features) {
+            extract_features(source);
+            extract_features(destination);
+        }
         // std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("vanilla");
         // icp->begin(source.points, destination.points, icp::RBTransform());
         // icp->iterate();
         // return 1;
         if (*use_gui) {
-            icp::ICP::Config config;
             config.set("overlap_rate", 0.7);
             LidarView* view = new LidarView(source.points, destination.points,
                 method, config);
@@ -252,7 +678,10 @@ int main(int argc, const char** argv) {
             launch_gui(view,
                 std::string(f_src) + std::string(" and ") + std::string(f_dst));
         } else if (*do_bench) {
-            run_benchmark(method, source, destination);
+            run_benchmark(method, source, destination, config,
+                std::stoul(burn_in), *use_initial_guess);
+        } else if (*do_record) {
+            run_recording(method, source, destination, config, f_record);
         }
     }
 }
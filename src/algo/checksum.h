@@ -0,0 +1,34 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/** The checksum of no bytes. */
+#define CHECKSUM_BASIS 0xcbf29ce484222325ull
+
+/**
+ * Extends the 64-bit checksum `hash` with the `size` bytes at `data`. This
+ * is FNV-1a taken 8 bytes at a time rather than 1, which is several times
+ * faster on large buffers. It is not cryptographic, but is enough to detect
+ * a corrupted or changed file.
+ */
+inline uint64_t checksum(const void* data, size_t size,
+    uint64_t hash = CHECKSUM_BASIS) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 32;
+    }
+    for (; size > 0; size--, bytes++) {
+        hash = (hash ^ *bytes) * 0x100000001b3ull;
+    }
+    return hash;
+}
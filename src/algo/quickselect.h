@@ -4,3 +4,34 @@
  */
 
 #pragma once
+
+#include <algorithm>
+#include <stddef.h>
+
+/**
+ * Partially sorts `[first, last)` so that, for every rank `k` in
+ * `[ranks_first, ranks_last)`, `first[k]` is the element that would be there
+ * if the range were fully sorted. Consequently, the elements between two
+ * consecutive ranks are exactly the elements between those ranks in sorted
+ * order, although in no particular order themselves.
+ *
+ * \par Efficiency:
+ * Expected `O(n log r)` comparisons, where `n` is the length of the range
+ * and `r` is the number of ranks. This is roughly one selection pass for a
+ * handful of ranks, as opposed to the `O(n log n)` of a full sort.
+ *
+ * @pre The ranks are strictly increasing and less than `last - first`.
+ */
+template<typename RandomIt, typename RankIt, typename Compare>
+void multiselect(RandomIt first, RandomIt last, RankIt ranks_first,
+    RankIt ranks_last, Compare comp, size_t offset = 0) {
+    if (ranks_first == ranks_last) {
+        return;
+    }
+    RankIt mid = ranks_first + (ranks_last - ranks_first) / 2;
+    RandomIt nth = first + (*mid - offset);
+    std::nth_element(first, nth, last, comp);
+    multiselect(first, nth, ranks_first, mid, comp, offset);
+    multiselect(nth + 1, last, mid + 1, ranks_last, comp,
+        offset + (nth + 1 - first));
+}
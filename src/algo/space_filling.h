@@ -0,0 +1,51 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <utility>
+
+/**
+ * The position of the cell `(x, y)` along the Z-order (Morton) curve through
+ * a 65536 by 65536 grid, found by interleaving the bits of the coordinates.
+ */
+inline uint32_t morton_index(uint16_t x, uint16_t y) {
+    auto spread = [](uint32_t v) {
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+/**
+ * The position of the cell `(x, y)` along the Hilbert curve through a 65536
+ * by 65536 grid. Unlike the Z-order curve, consecutive cells along it are
+ * always adjacent, so it has no long jumps between quadrants.
+ */
+inline uint32_t hilbert_index(uint16_t x, uint16_t y) {
+    constexpr uint32_t n = 1u << 16;
+    uint32_t u = x;
+    uint32_t v = y;
+    uint32_t index = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2) {
+        const uint32_t rx = (u & s) > 0;
+        const uint32_t ry = (v & s) > 0;
+        index += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the curve enters it correctly
+        if (ry == 0) {
+            if (rx == 1) {
+                u = n - 1 - u;
+                v = n - 1 - v;
+            }
+            std::swap(u, v);
+        }
+    }
+    return index;
+}
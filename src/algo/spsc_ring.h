@@ -0,0 +1,105 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * A bounded, lock-free queue between exactly one producer thread and one
+ * consumer thread. The slots are allocated once on construction and reused,
+ * so elements are filled and read in place rather than copied in and out.
+ *
+ * \par Example
+ * @code
+ * // Producer
+ * if (T* slot = ring.acquire()) {
+ *     fill(*slot);
+ *     ring.commit();
+ * }
+ *
+ * // Consumer
+ * if (T* slot = ring.front()) {
+ *     use(*slot);
+ *     ring.release();
+ * }
+ * @endcode
+ */
+template<typename T>
+class SPSCRing {
+    std::vector<T> slots;
+    size_t mask;
+
+    // Each index is written by one side only; keep them on separate cache
+    // lines so the two threads do not contend
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    /** Constructs a ring holding at least `capacity` default-constructed
+     * elements. */
+    SPSCRing(size_t capacity): head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    /** The number of elements the ring can hold. */
+    size_t capacity() const {
+        return slots.size();
+    }
+
+    /** The `i`th slot, for preparing the slots before the ring is shared
+     * between threads. */
+    T& slot(size_t i) {
+        return slots[i];
+    }
+
+    /** The number of committed elements not yet released. Exact only when
+     * called from the producer or consumer thread. */
+    size_t size() const {
+        return tail.load(std::memory_order_acquire)
+               - head.load(std::memory_order_acquire);
+    }
+
+    /** Producer: the next free slot to fill, or `nullptr` if the ring is
+     * full. */
+    T* acquire() {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size()) {
+            return nullptr;
+        }
+        return &slots[t & mask];
+    }
+
+    /** Producer: publishes the slot returned by the last SPSCRing::acquire.
+     */
+    void commit() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+    }
+
+    /** Consumer: the oldest committed slot, or `nullptr` if the ring is
+     * empty. */
+    T* front() {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[h & mask];
+    }
+
+    /** Consumer: returns the slot returned by SPSCRing::front to the
+     * producer. */
+    void release() {
+        head.store(head.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+    }
+};
@@ -0,0 +1,77 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <algorithm>
+#include <Eigen/Cholesky>
+#include "anderson.h"
+
+namespace icp {
+    Anderson::Anderson(size_t depth)
+        : depth(std::min(depth, max_depth)), count(0), has_previous(false) {}
+
+    void Anderson::clear() {
+        count = 0;
+        has_previous = false;
+    }
+
+    Anderson::Params Anderson::params_of(const RBTransform& t,
+        double reference) {
+        // Unwrap the angle to lie within half a turn of `reference`
+        double theta = std::atan2(t.rotation(1, 0), t.rotation(0, 0));
+        theta += 2 * M_PI * std::round((reference - theta) / (2 * M_PI));
+        return Params(t.translation.x(), t.translation.y(), theta);
+    }
+
+    RBTransform Anderson::extrapolate(const RBTransform& x_transform,
+        const RBTransform& g_transform) {
+        const Params x = params_of(x_transform,
+            has_previous ? previous_x(2) : 0);
+        const Params g = params_of(g_transform, x(2));
+        const Params f = g - x;
+
+        // Shift the history of differences, dropping the oldest
+        if (has_previous && depth > 0) {
+            const size_t slots = std::min(count + 1, depth);
+            for (size_t i = slots - 1; i > 0; i--) {
+                delta_f[i] = delta_f[i - 1];
+                delta_g[i] = delta_g[i - 1];
+            }
+            delta_f[0] = f - previous_f;
+            delta_g[0] = g - previous_g;
+            count = slots;
+        }
+        has_previous = true;
+        previous_x = x;
+        previous_f = f;
+        previous_g = g;
+
+        Params next = g;
+        if (count > 0) {
+            // Solve min |f - dF gamma| by regularized normal equations, as
+            // there are often more differences than parameters
+            using Small = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+                0, max_depth, max_depth>;
+            using SmallVector = Eigen::Matrix<double, Eigen::Dynamic, 1, 0,
+                max_depth, 1>;
+            Small normal(count, count);
+            SmallVector rhs(count);
+            for (size_t i = 0; i < count; i++) {
+                rhs(i) = delta_f[i].dot(f);
+                for (size_t j = 0; j < count; j++) {
+                    normal(i, j) = delta_f[i].dot(delta_f[j]);
+                }
+            }
+            normal.diagonal().array() += 1e-10 * (normal.trace() + 1e-30);
+            const SmallVector gamma = normal.ldlt().solve(rhs);
+            for (size_t i = 0; i < count; i++) {
+                next -= gamma(i) * delta_g[i];
+            }
+        }
+
+        return RBTransform(Vector(next(0), next(1)),
+            Matrix{{std::cos(next(2)), -std::sin(next(2))},
+                {std::sin(next(2)), std::cos(next(2))}});
+    }
+}
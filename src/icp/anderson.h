@@ -0,0 +1,51 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include "geo.h"
+
+namespace icp {
+    /**
+     * Anderson acceleration of the fixed-point iteration `x = G(x)` over the
+     * parameters (translation x, translation y, rotation angle) of an
+     * RBTransform. Given the last few iterates and their images under `G`,
+     * it extrapolates to the combination of images whose residuals
+     * `G(x) - x` cancel best.
+     *
+     * All storage is inline, so no heap allocation is performed.
+     */
+    class Anderson {
+    public:
+        /** The largest supported history depth. */
+        static constexpr size_t max_depth = 8;
+
+        /** Constructs an empty history that keeps the last `depth` (at most
+         * Anderson::max_depth) differences between iterates. */
+        Anderson(size_t depth);
+
+        /** Forgets all previous iterates. */
+        void clear();
+
+        /** Adds the iterate `x` and its image `g` under the fixed-point
+         * map, returning the extrapolated next iterate. */
+        RBTransform extrapolate(const RBTransform& x, const RBTransform& g);
+
+    private:
+        using Params = Eigen::Vector3d;
+
+        size_t depth;
+        size_t count;
+        bool has_previous;
+        Params previous_x;
+        Params previous_f;
+        Params previous_g;
+        Params delta_f[max_depth];
+        Params delta_g[max_depth];
+
+        static Params params_of(const RBTransform& t, double reference);
+    };
+}
@@ -0,0 +1,400 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "distance_field.h"
+#include "../algo/checksum.h"
+
+// Stands in for infinity in the distance transform, where it must survive
+// arithmetic
+#define FAR 1e20
+
+#define FIELD_MAGIC "ICPF"
+#define FIELD_VERSION 2
+#define FIELD_HEADER_SIZE 72
+
+namespace icp {
+    DistanceField::DistanceField(double resolution, double margin)
+        : resolution(resolution),
+          margin(margin),
+          origin(Vector::Zero()),
+          grid_width(0),
+          grid_height(0) {}
+
+    long DistanceField::column_of(double x) const {
+        return (long)std::floor((x - origin.x()) / resolution);
+    }
+
+    long DistanceField::row_of(double y) const {
+        return (long)std::floor((y - origin.y()) / resolution);
+    }
+
+    /**
+     * The one-dimensional squared distance transform of the `n` samples of
+     * `f`, storing the distances in `d` and the minimizing sample in `arg`.
+     * `v` and `z` are scratch space for `n` and `n + 1` values.
+     *
+     * Computes the lower envelope of the parabolas rooted at each sample.
+     * Source: https://doi.org/10.4086/toc.2012.v008a019
+     */
+    static void transform_1d(const double* f, long n, double* d, long* arg,
+        long* v, double* z) {
+        long k = 0;
+        v[0] = 0;
+        z[0] = -INFINITY;
+        z[1] = INFINITY;
+        for (long q = 1; q < n; q++) {
+            // Pop the parabolas the new one hides; `z[0]` stops this
+            double s;
+            for (;; k--) {
+                const long r = v[k];
+                s = ((f[q] + q * q) - (f[r] + r * r)) / (2.0 * (q - r));
+                if (s > z[k]) {
+                    break;
+                }
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = INFINITY;
+        }
+
+        k = 0;
+        for (long q = 0; q < n; q++) {
+            while (z[k + 1] < q) {
+                k++;
+            }
+            d[q] = (double)(q - v[k]) * (q - v[k]) + f[v[k]];
+            arg[q] = v[k];
+        }
+    }
+
+    void DistanceField::build(const std::vector<Vector>& points) {
+        field_points = points;
+
+        Vector min = Vector::Constant(INFINITY);
+        Vector max = Vector::Constant(-INFINITY);
+        for (const Vector& point: points) {
+            min = min.cwiseMin(point);
+            max = max.cwiseMax(point);
+        }
+        if (points.empty()) {
+            min = max = Vector::Zero();
+        }
+        origin = min - Vector::Constant(margin);
+        grid_width = (long)std::ceil((max.x() - min.x() + 2 * margin)
+                                     / resolution)
+                     + 1;
+        grid_height = (long)std::ceil((max.y() - min.y() + 2 * margin)
+                                      / resolution)
+                      + 1;
+        const size_t cell_count = grid_width * grid_height;
+
+        // Bucket the points by cell (counting sort)
+        cell_start.assign(cell_count + 1, 0);
+        for (const Vector& point: points) {
+            cell_start[row_of(point.y()) * grid_width + column_of(point.x())
+                       + 1]++;
+        }
+        for (size_t c = 0; c < cell_count; c++) {
+            cell_start[c + 1] += cell_start[c];
+        }
+        cell_points.resize(points.size());
+        std::vector<uint32_t> next(cell_start.begin(), cell_start.end() - 1);
+        for (size_t j = 0; j < points.size(); j++) {
+            const long c = row_of(points[j].y()) * grid_width
+                           + column_of(points[j].x());
+            cell_points[next[c]++] = j;
+        }
+
+        // Distances between cells, along columns and then along rows, to
+        // the nearest cell containing a point
+        const long longest = std::max(grid_width, grid_height);
+        std::vector<double> f(longest);
+        std::vector<double> d(longest);
+        std::vector<long> arg(longest);
+        std::vector<long> v(longest);
+        std::vector<double> z(longest + 1);
+        std::vector<double> column_distance(cell_count);
+        std::vector<long> column_arg(cell_count);
+        for (long x = 0; x < grid_width; x++) {
+            for (long y = 0; y < grid_height; y++) {
+                const long c = y * grid_width + x;
+                f[y] = cell_start[c] == cell_start[c + 1] ? FAR : 0;
+            }
+            transform_1d(f.data(), grid_height, d.data(), arg.data(),
+                v.data(), z.data());
+            for (long y = 0; y < grid_height; y++) {
+                column_distance[y * grid_width + x] = d[y];
+                column_arg[y * grid_width + x] = arg[y];
+            }
+        }
+
+        cell_nearest.resize(cell_count);
+        for (long y = 0; y < grid_height; y++) {
+            transform_1d(column_distance.data() + y * grid_width, grid_width,
+                d.data(), arg.data(), v.data(), z.data());
+            for (long x = 0; x < grid_width; x++) {
+                uint32_t& nearest = cell_nearest[y * grid_width + x];
+                if (points.empty()) {
+                    nearest = 0;
+                    continue;
+                }
+
+                // The closest point to this cell's center within the
+                // nearest nonempty cell
+                const long source_x = arg[x];
+                const long source_y = column_arg[y * grid_width + source_x];
+                const long source = source_y * grid_width + source_x;
+                const Vector center = origin
+                                      + resolution * Vector(x + 0.5, y + 0.5);
+                double closest = INFINITY;
+                for (uint32_t k = cell_start[source];
+                     k < cell_start[source + 1]; k++) {
+                    const double dist = (points[cell_points[k]] - center)
+                                            .squaredNorm();
+                    if (dist < closest) {
+                        closest = dist;
+                        nearest = cell_points[k];
+                    }
+                }
+            }
+        }
+    }
+
+    const std::vector<Vector>& DistanceField::points() const {
+        return field_points;
+    }
+
+    size_t DistanceField::nearest(const Vector& query, double& sq_dist,
+        size_t& evaluations) const {
+        const long x = std::clamp(column_of(query.x()), 0L, grid_width - 1);
+        const long y = std::clamp(row_of(query.y()), 0L, grid_height - 1);
+        size_t best = cell_nearest[y * grid_width + x];
+        sq_dist = (field_points[best] - query).squaredNorm();
+        evaluations = 1;
+
+        // The closest point is no farther than the candidate
+        const double radius = std::sqrt(sq_dist);
+        const long x0 = std::max(column_of(query.x() - radius), 0L);
+        const long x1 = std::min(column_of(query.x() + radius),
+            grid_width - 1);
+        const long y0 = std::max(row_of(query.y() - radius), 0L);
+        const long y1 = std::min(row_of(query.y() + radius), grid_height - 1);
+
+        // Far outside the grid, checking everything is cheaper
+        if ((size_t)((x1 - x0 + 1) * (y1 - y0 + 1)) > field_points.size()) {
+            for (size_t j = 0; j < field_points.size(); j++) {
+                const double dist = (field_points[j] - query).squaredNorm();
+                if (dist < sq_dist || (dist == sq_dist && j < best)) {
+                    sq_dist = dist;
+                    best = j;
+                }
+            }
+            evaluations += field_points.size();
+            return best;
+        }
+
+        for (long cy = y0; cy <= y1; cy++) {
+            for (long cx = x0; cx <= x1; cx++) {
+                const long c = cy * grid_width + cx;
+                for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; k++) {
+                    const size_t j = cell_points[k];
+                    const double dist = (field_points[j] - query)
+                                            .squaredNorm();
+                    if (dist < sq_dist || (dist == sq_dist && j < best)) {
+                        sq_dist = dist;
+                        best = j;
+                    }
+                }
+                evaluations += cell_start[c + 1] - cell_start[c];
+            }
+        }
+        return best;
+    }
+
+    template<typename T>
+    static bool write_array(FILE* file, const std::vector<T>& values) {
+        return values.empty()
+               || fwrite(values.data(), sizeof(T), values.size(), file)
+                      == values.size();
+    }
+
+    template<typename T>
+    static uint64_t hash_array(const std::vector<T>& values, uint64_t hash) {
+        return checksum(values.data(), values.size() * sizeof(T), hash);
+    }
+
+    template<typename T>
+    static const uint8_t* read_array(const uint8_t* data,
+        std::vector<T>& values, size_t count) {
+        values.resize(count);
+        memcpy(static_cast<void*>(values.data()), data, count * sizeof(T));
+        return data + count * sizeof(T);
+    }
+
+    bool DistanceField::save(const std::string& path) const {
+        const std::string temporary = path + ".tmp";
+        FILE* file = fopen(temporary.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+
+        uint64_t sum = CHECKSUM_BASIS;
+        sum = hash_array(field_points, sum);
+        sum = hash_array(cell_nearest, sum);
+        sum = hash_array(cell_start, sum);
+        sum = hash_array(cell_points, sum);
+
+        const uint32_t version = FIELD_VERSION;
+        const double values[4] = {resolution, margin, origin.x(),
+            origin.y()};
+        const uint64_t sizes[4] = {(uint64_t)grid_width,
+            (uint64_t)grid_height, field_points.size(), sum};
+        bool ok = fwrite(FIELD_MAGIC, 4, 1, file) == 1
+                  && fwrite(&version, sizeof(version), 1, file) == 1
+                  && fwrite(values, sizeof(values), 1, file) == 1
+                  && fwrite(sizes, sizeof(sizes), 1, file) == 1
+                  && write_array(file, field_points)
+                  && write_array(file, cell_nearest)
+                  && write_array(file, cell_start)
+                  && write_array(file, cell_points);
+        ok = fclose(file) == 0 && ok
+             && rename(temporary.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            remove(temporary.c_str());
+        }
+        return ok;
+    }
+
+    bool DistanceField::load(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < FIELD_HEADER_SIZE) {
+            ::close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        const uint8_t* data = static_cast<const uint8_t*>(mapping);
+        const size_t length = info.st_size;
+
+        uint32_t version;
+        double values[4];
+        uint64_t sizes[4];
+        memcpy(&version, data + 4, sizeof(version));
+        memcpy(values, data + 8, sizeof(values));
+        memcpy(sizes, data + 40, sizeof(sizes));
+        const uint64_t count = sizes[2];
+
+        // Each size is bounded by what the file could hold before any is
+        // multiplied, so that a corrupted header cannot overflow the checks
+        const size_t available = length - FIELD_HEADER_SIZE;
+        bool ok = memcmp(data, FIELD_MAGIC, 4) == 0
+                  && version == FIELD_VERSION && values[0] == resolution
+                  && values[1] == margin && sizes[0] > 0 && sizes[1] > 0
+                  && sizes[1] <= available / (2 * sizeof(uint32_t)) / sizes[0]
+                  && count <= available / (sizeof(Vector) + sizeof(uint32_t))
+                  && count <= UINT32_MAX;
+        if (!ok) {
+            munmap(mapping, length);
+            return false;
+        }
+        const uint64_t cell_count = sizes[0] * sizes[1];
+        ok = length == FIELD_HEADER_SIZE
+                           + count * (sizeof(Vector) + sizeof(uint32_t))
+                           + (2 * cell_count + 1) * sizeof(uint32_t);
+
+        // The arrays, checksummed in turn as DistanceField::save does
+        const uint8_t* start = data + FIELD_HEADER_SIZE
+                               + count * sizeof(Vector);
+        const uint32_t* mapped_nearest = reinterpret_cast<const uint32_t*>(
+            start);
+        const uint32_t* mapped_start = mapped_nearest + cell_count;
+        const uint32_t* mapped_points = mapped_start + cell_count + 1;
+        if (ok) {
+            uint64_t sum = checksum(data + FIELD_HEADER_SIZE,
+                count * sizeof(Vector));
+            sum = checksum(mapped_nearest, cell_count * sizeof(uint32_t), sum);
+            sum = checksum(mapped_start, (cell_count + 1) * sizeof(uint32_t),
+                sum);
+            sum = checksum(mapped_points, count * sizeof(uint32_t), sum);
+            ok = sum == sizes[3];
+        }
+
+        // Check every index once so that queries never read out of bounds
+        for (uint64_t c = 0; ok && c < cell_count; c++) {
+            ok = (count == 0 || mapped_nearest[c] < count)
+                 && mapped_start[c] <= mapped_start[c + 1];
+        }
+        ok = ok && mapped_start[0] == 0 && mapped_start[cell_count] == count;
+        for (uint64_t k = 0; ok && k < count; k++) {
+            ok = mapped_points[k] < count;
+        }
+
+        if (ok) {
+            origin = Vector(values[2], values[3]);
+            grid_width = sizes[0];
+            grid_height = sizes[1];
+            const uint8_t* next = data + FIELD_HEADER_SIZE;
+            next = read_array(next, field_points, count);
+            next = read_array(next, cell_nearest, cell_count);
+            next = read_array(next, cell_start, cell_count + 1);
+            read_array(next, cell_points, count);
+        }
+        munmap(mapping, length);
+        return ok;
+    }
+
+    bool DistanceField::build_cached(const std::vector<Vector>& points,
+        const std::string& directory) {
+        // Name the file after everything the field is computed from
+        const double parameters[2] = {resolution, margin};
+        const uint64_t key = checksum(points.data(),
+            points.size() * sizeof(Vector),
+            checksum(parameters, sizeof(parameters)));
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.icpfield",
+            (unsigned long long)key);
+        const std::string path = directory + "/" + name;
+
+        if (load(path) && field_points == points) {
+            return true;
+        }
+        build(points);
+        save(path);
+        return false;
+    }
+
+    size_t DistanceField::width() const {
+        return grid_width;
+    }
+
+    size_t DistanceField::height() const {
+        return grid_height;
+    }
+
+    size_t DistanceField::memory_usage() const {
+        return field_points.capacity() * sizeof(Vector)
+               + cell_nearest.capacity() * sizeof(uint32_t)
+               + cell_start.capacity() * sizeof(uint32_t)
+               + cell_points.capacity() * sizeof(uint32_t);
+    }
+}
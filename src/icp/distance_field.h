@@ -0,0 +1,122 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "geo.h"
+
+namespace icp {
+    /**
+     * A precomputed Euclidean distance transform of a point cloud, for
+     * answering many exact nearest-point queries against the same cloud.
+     *
+     * A grid of square cells is laid over the bounding box of the points,
+     * grown by a margin on every side. An exact distance transform over the
+     * cells that contain points gives each cell the index of a point close
+     * to its center. A query looks up the cell of the query
+     * point and then refines that candidate by checking the points in every
+     * cell within the candidate's distance, so results are always exact; the
+     * field only makes the search small.
+     *
+     * \par Example
+     * @code
+     * icp::DistanceField field(5, 100);
+     * field.build(map);
+     * double sq_dist;
+     * size_t evaluations;
+     * size_t closest = field.nearest(query, sq_dist, evaluations);
+     * @endcode
+     *
+     * \par File Format
+     * All values are stored in host byte order.
+     * 1. The magic bytes `ICPF` and the `uint32_t` version.
+     * 2. The resolution, margin, and grid origin as `double`s.
+     * 3. The grid width, grid height, and point count as `uint64_t`s, and
+     * the `uint64_t` FNV-1a checksum of everything that follows.
+     * 4. The points as `double` pairs, the `uint32_t` index of the point
+     * closest to each cell, and the `uint32_t` start of each cell's points
+     * (plus one past the last) and point indices by cell.
+     */
+    class DistanceField {
+    public:
+        /** Constructs an empty field with square cells of side `resolution`
+         * extending `margin` beyond the points, both in the units of the
+         * points. */
+        DistanceField(double resolution, double margin);
+
+        /** Precomputes the field for `points`, replacing any previous ones.
+         *
+         * \par Efficiency:
+         * `O(points.size() + cells)`. */
+        void build(const std::vector<Vector>& points);
+
+        /** The points the field was built for. */
+        const std::vector<Vector>& points() const;
+
+        /** Writes the field to `path`, through a temporary file renamed
+         * into place so that readers never see it partly written, returning
+         * `false` on failure. */
+        bool save(const std::string& path) const;
+
+        /** Maps the field saved at `path` and reads it in with bulk copies,
+         * returning `false`, leaving this field unchanged, if the file could
+         * not be read, is not a valid field, fails its checksum, or was
+         * saved with a different resolution or margin. */
+        bool load(const std::string& path);
+
+        /**
+         * Builds the field for `points` as DistanceField::build does, unless
+         * an earlier call saved the same field to `directory`, in which case
+         * it is loaded instead. A missing, stale, or corrupted file is
+         * rebuilt and saved again, so the directory need not be managed.
+         *
+         * \par Efficiency:
+         * `O(points.size() + cells)`, but with the small constant of
+         * hashing and copying memory when the field is loaded.
+         *
+         * @returns Whether the field was loaded rather than built.
+         */
+        bool build_cached(const std::vector<Vector>& points,
+            const std::string& directory);
+
+        /**
+         * The index of the point closest to `query`, storing the squared
+         * distance to it in `sq_dist` and the number of point distances
+         * computed in `evaluations`. The first point wins ties.
+         *
+         * @pre The field was built for at least one point.
+         */
+        size_t nearest(const Vector& query, double& sq_dist,
+            size_t& evaluations) const;
+
+        /** The number of cells along each axis. */
+        size_t width() const;
+        size_t height() const;
+
+        /** The number of bytes of heap memory held by the field. */
+        size_t memory_usage() const;
+
+    private:
+        double resolution;
+        double margin;
+        Vector origin;
+        long grid_width;
+        long grid_height;
+        std::vector<Vector> field_points;
+
+        /** The index of the closest point to the center of each cell. */
+        std::vector<uint32_t> cell_nearest;
+
+        /** The points in each cell, stored contiguously by cell. */
+        std::vector<uint32_t> cell_start;
+        std::vector<uint32_t> cell_points;
+
+        long column_of(double x) const;
+        long row_of(double y) const;
+    };
+}
@@ -0,0 +1,182 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "features.h"
+
+namespace icp {
+    FeatureExtractor::FeatureExtractor(FeatureParams params)
+        : params(params) {}
+
+    bool FeatureExtractor::is_break(const Vector& previous,
+        const Vector& next) const {
+        const double range = std::min(previous.norm(), next.norm());
+        const double threshold = std::max(params.break_distance,
+            params.break_ratio * range);
+        return (next - previous).squaredNorm() > threshold * threshold;
+    }
+
+    size_t FeatureExtractor::index(size_t position) const {
+        return (position + origin) % count;
+    }
+
+    size_t FeatureExtractor::farthest_point(const std::vector<Vector>& points,
+        size_t start, size_t end, double& distance) const {
+        const Vector& from = points[index(start)];
+        const Vector chord = points[index(end)] - from;
+        const double length = chord.norm();
+        size_t farthest = start;
+        distance = 0;
+        for (size_t p = start + 1; p < end; p++) {
+            const Vector offset = points[index(p)] - from;
+            const double d = length > 0 ? std::abs(chord.x() * offset.y()
+                                                   - chord.y() * offset.x())
+                                              / length
+                                        : offset.norm();
+            if (d > distance) {
+                distance = d;
+                farthest = p;
+            }
+        }
+        return farthest;
+    }
+
+    void FeatureExtractor::fit_lines(const std::vector<Vector>& points,
+        size_t first, size_t last) {
+        // Split until every point lies near its line, taking the earlier
+        // half first so that the lines come out in order
+        const size_t begin = lines.size();
+        pending.clear();
+        pending.emplace_back(first, last);
+        while (!pending.empty()) {
+            const auto [start, end] = pending.back();
+            pending.pop_back();
+            double distance;
+            const size_t farthest = farthest_point(points, start, end,
+                distance);
+            if (distance > params.line_tolerance) {
+                pending.emplace_back(farthest, end);
+                pending.emplace_back(start, farthest);
+            } else {
+                lines.emplace_back(start, end);
+            }
+        }
+
+        // Merge neighbors that a single line still fits, since a split is
+        // chosen against a chord that may span several walls. Those that
+        // stay apart meet where they bend most, which merging a beam or two
+        // past a corner would otherwise shift
+        size_t merged = begin;
+        for (size_t k = begin + 1; k < lines.size(); k++) {
+            double distance;
+            const size_t corner = farthest_point(points, lines[merged].first,
+                lines[k].second, distance);
+            if (distance <= params.line_tolerance) {
+                lines[merged].second = lines[k].second;
+            } else {
+                lines[merged].second = corner;
+                lines[++merged] = {corner, lines[k].second};
+            }
+        }
+        lines.resize(merged + 1);
+    }
+
+    void FeatureExtractor::keep_lines(size_t begin, bool is_loop) {
+        for (size_t k = begin; k < lines.size(); k++) {
+            const auto [start, end] = lines[k];
+
+            // Where two lines meet is a corner
+            if (k > begin || is_loop) {
+                keep[index(start)] = 1;
+            }
+
+            // Sample the line by beam so it keeps the density of the scan
+            for (size_t p = start + 1; p < end; p++) {
+                if (index(p) % params.sample_stride == 0) {
+                    keep[index(p)] = 1;
+                }
+            }
+        }
+    }
+
+    size_t FeatureExtractor::extract(const std::vector<Vector>& points,
+        std::vector<Vector>& features) {
+        const size_t n = points.size();
+        keep.assign(n, 0);
+        lines.clear();
+        count = n;
+        origin = 0;
+
+        // A full turn continues across the ends of the scan, so start at a
+        // jump instead, or treat the scan as one loop if there is none
+        const bool is_closed = n > 2 && !is_break(points[n - 1], points[0]);
+        bool is_loop = is_closed;
+        for (size_t i = 1; is_closed && i < n; i++) {
+            if (is_break(points[i - 1], points[i])) {
+                origin = i;
+                is_loop = false;
+                break;
+            }
+        }
+
+        if (is_loop) {
+            fit_lines(points, 0, n - 1);
+
+            // The first and last lines meet across the ends of the scan,
+            // either as one line or at the corner farthest from it
+            if (lines.size() > 1) {
+                double distance;
+                const size_t corner = farthest_point(points,
+                    lines.back().first, lines[0].second + n, distance);
+                if (distance <= params.line_tolerance) {
+                    lines[0].first = lines.back().first;
+                    lines.pop_back();
+                } else {
+                    lines.back().second = corner;
+                    lines[0].first = corner;
+                }
+                lines[0].second += n;
+            }
+            keep_lines(0, true);
+        }
+
+        size_t first = 0;
+        for (size_t i = 1; !is_loop && i <= n; i++) {
+            if (i < n && !is_break(points[index(i - 1)], points[index(i)])) {
+                continue;
+            }
+
+            // Segments too short to fit a line to are noise or clutter
+            if (i - first >= params.min_segment_points) {
+                const size_t begin = lines.size();
+                fit_lines(points, first, i - 1);
+                keep_lines(begin, false);
+
+                // Only the nearer side of a jump is a real edge; the other
+                // is wherever the occluding object's shadow happens to fall
+                const Vector& start = points[index(first)];
+                const Vector& end = points[index(i - 1)];
+                if ((first > 0 || is_closed)
+                    && start.norm() < points[index(first + n - 1)].norm()) {
+                    keep[index(first)] = 1;
+                }
+                if ((i < n || is_closed)
+                    && end.norm() < points[index(i)].norm()) {
+                    keep[index(i - 1)] = 1;
+                }
+            }
+            first = i;
+        }
+
+        features.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (keep[i]) {
+                features.push_back(points[i]);
+            }
+        }
+        return features.size();
+    }
+}
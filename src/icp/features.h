@@ -0,0 +1,103 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include "geo.h"
+
+namespace icp {
+    /** Tuning for a FeatureExtractor, in the units of the point clouds. */
+    struct FeatureParams {
+        /** The least distance between consecutive points that separates two
+         * segments. */
+        double break_distance = 15;
+
+        /** The fraction of a point's range by which the break distance grows,
+         * since beams spread apart with distance. */
+        double break_ratio = 0.05;
+
+        /** How far points may lie from a fitted line. */
+        double line_tolerance = 10;
+
+        /** Every `sample_stride`th beam along a line is kept. */
+        size_t sample_stride = 8;
+
+        /** Segments with fewer points are discarded as noise. */
+        size_t min_segment_points = 4;
+    };
+
+    /**
+     * Reduces an angularly ordered scan, such as one from a PolarConverter,
+     * to the points that constrain its alignment.
+     *
+     * The scan is split into segments wherever consecutive points jump
+     * apart, and each segment is split into lines until every point lies
+     * near its line, after which neighboring lines that fit a single line
+     * are merged again (split-and-merge). A scan whose ends meet, such as a
+     * full turn, is treated as continuing across them. The corners between
+     * lines and the endpoints on the near side of each jump are kept along
+     * with every few beams of each line. Sampling by beam rather than by
+     * distance keeps the density of the scan, which the centroid-based
+     * solvers rely on when the source and destination are reduced alike.
+     *
+     * \par Example
+     * @code
+     * icp::FeatureExtractor extractor;
+     * extractor.extract(scan_points, source_features);
+     * extractor.extract(other_points, destination_features);
+     * icp->begin(source_features, destination_features, icp::RBTransform());
+     * @endcode
+     */
+    class FeatureExtractor {
+        FeatureParams params;
+        std::vector<char> keep;
+        std::vector<std::pair<size_t, size_t>> pending;
+
+        /** The first and last position of each line found so far. */
+        std::vector<std::pair<size_t, size_t>> lines;
+
+        /** Positions count around the scan from the point at `origin`,
+         * past the end and back to the start, since the `count` points may
+         * continue across the ends. */
+        size_t origin;
+        size_t count;
+
+        bool is_break(const Vector& previous, const Vector& next) const;
+
+        /** The index of the point at `position`. */
+        size_t index(size_t position) const;
+
+        /** The position strictly between `start` and `end` farthest from
+         * the chord between them, or `start` if there is none, storing its
+         * distance from the chord in `distance`. */
+        size_t farthest_point(const std::vector<Vector>& points, size_t start,
+            size_t end, double& distance) const;
+
+        /** Appends to `lines` the split-and-merge fit of the positions from
+         * `first` to `last`. */
+        void fit_lines(const std::vector<Vector>& points, size_t first,
+            size_t last);
+
+        /** Keeps the corners and samples of the lines from the `begin`th
+         * on. The first line's start is only a corner if `is_loop`. */
+        void keep_lines(size_t begin, bool is_loop);
+
+    public:
+        FeatureExtractor(FeatureParams params = FeatureParams());
+
+        /**
+         * Stores in `features` the points of `points`, which must be in
+         * angular order around the sensor at the origin, that are corners,
+         * segment endpoints, or samples along lines, in their original
+         * order. Storage is reused across calls.
+         *
+         * @returns The number of points kept.
+         */
+        size_t extract(const std::vector<Vector>& points,
+            std::vector<Vector>& features);
+    };
+}
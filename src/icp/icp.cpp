@@ -3,21 +3,67 @@
  * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
  */
 
+#include <algorithm>
 #include <numeric>
+#include <Eigen/LU>
 #include "icp.h"
+#include "trace.h"
+#include "anderson.h"
+#include "timeline.h"
+#include "../algo/space_filling.h"
 
 namespace icp {
     static Methods* global;
 
-    ICP::ICP() {}
+    ICP::ICP()
+        : inlier_count(0),
+          matched_count(0),
+          trace(nullptr),
+          lazy_matching(false),
+          anderson_depth(0),
+          distance_evaluations(0),
+          is_budgeted(false),
+          step_progress(0),
+          has_stepped_matches(false),
+          is_interrupted(false),
+          sample_fraction(1),
+          sample_growth(2),
+          spatial_order(SpatialOrder::none) {
+        reserve_points(a);
+        reserve_points(b);
+        reserve_points(matches);
+    }
 
     void ICP::setup() {}
 
-    void ICP::begin(const std::vector<Vector>& a, const std::vector<Vector>& b,
+    size_t ICP::method_memory_usage() const {
+        return 0;
+    }
+
+    bool ICP::matches_by_point() const {
+        return true;
+    }
+
+    bool ICP::begin(const std::vector<Vector>& a, const std::vector<Vector>& b,
         RBTransform t) {
+        Timeline::Span span("begin");
+
+        if (a.size() > max_points || b.size() > max_points) {
+            return false;
+        }
+#ifdef ICP_COMPACT_MATCHES
+        if (a.size() > UINT32_MAX || b.size() > UINT32_MAX) {
+            return false;
+        }
+#endif
+
         // Initial transform guess
         this->transform = t;
 
+        if (trace) {
+            trace->begin(a, b);
+        }
+
         // Copy in point clouds
         this->a = a;
         this->b = b;
@@ -32,19 +78,289 @@ namespace icp {
             point -= b_cm;
         }
 
+        // Sort for locality once the centroids no longer depend on order
+        if (spatial_order != SpatialOrder::none) {
+            sort_along_curve(this->a, a_order);
+            sort_along_curve(this->b, b_order);
+        }
+
+        // Samples are drawn from the whole cloud, reproducibly
+        sample.clear();
+        if (sample_fraction < 1) {
+            whole_a = this->a;
+            sampler.seed(std::minstd_rand::default_seed);
+        }
+
         // Cost is infinite initially
+        distance_evaluations = 0;
+        step_progress = 0;
+        has_stepped_matches = false;
         previous_cost = std::numeric_limits<double>::infinity();
         current_cost = std::numeric_limits<double>::infinity();
 
-        // Ensure arrays are the right size
-        const size_t n = this->a.size();
-        if (matches.size() < n) {
-            matches.resize(n);
-            matches.resize(n);
+        // Ensure arrays are the right size (shrinking keeps the capacity, so
+        // stale matches from a larger previous run are never read)
+        matches.resize(this->a.size());
+        ranked_matches.clear();
+        matched_count = 0;
+        inlier_sums = InlierSums();
+
+        // The field depends only on the destination, so may be on disk
+        if (distance_field && distance_field->points() != this->b) {
+            if (field_cache.empty()) {
+                distance_field->build(this->b);
+            } else {
+                distance_field->build_cached(this->b, field_cache);
+            }
+        }
+
+        // Nothing has been searched for yet
+        if (lazy_matching) {
+            lazy_position.resize(this->a.size());
+            lazy_pair.resize(this->a.size());
+            lazy_margin.assign(this->a.size(), -1);
         }
 
         // Per-instance customization routine
         setup();
+        return true;
+    }
+
+    void ICP::compute_matches(const std::vector<Vector>& a_rot) {
+        // Methods that rank the matches do so after matching
+        const size_t n = a.size();
+        ranked_matches.clear();
+        matched_count = n;
+        inlier_sums = InlierSums();
+
+        // ICP::step already matched everything for this iteration
+        if (has_stepped_matches) {
+            has_stepped_matches = false;
+            return;
+        }
+        step_progress = 0;
+
+        Timeline::Span span("match");
+        matches.resize(n);
+
+        // A field lookup usually computes only a few distances
+        const size_t search_cost = distance_field ? 1 : b.size();
+
+        for (size_t i = 0; i < n; i++) {
+            // Reading the clock is cheap next to searching a few points
+            if (is_budgeted && !has_budget_for(search_cost, i % 8 == 0)) {
+                is_interrupted = true;
+
+                // The iteration will be discarded, but must still be able
+                // to read every match
+                matched_count = i;
+                for (; i < n; i++) {
+                    matches[i] = Match{0,
+                        std::numeric_limits<MatchDistance>::infinity()};
+                }
+                return;
+            }
+            match_point(i, a_rot[i]);
+        }
+    }
+
+    void ICP::match_point(size_t i, const Vector& rotated) {
+        if (distance_field) {
+            size_t evaluations;
+            double sq_dist;
+            matches[i].pair = distance_field->nearest(rotated, sq_dist,
+                evaluations);
+            matches[i].sq_dist = sq_dist;
+            distance_evaluations += evaluations;
+            return;
+        }
+
+        if (lazy_matching && lazy_margin[i] >= 0
+            && (rotated - lazy_position[i]).squaredNorm()
+                   <= lazy_margin[i] * lazy_margin[i]) {
+            matches[i].pair = lazy_pair[i];
+            matches[i].sq_dist = (b[lazy_pair[i]] - rotated).squaredNorm();
+            distance_evaluations++;
+            return;
+        }
+
+        const size_t m = b.size();
+        double closest = std::numeric_limits<double>::infinity();
+        double second_closest = std::numeric_limits<double>::infinity();
+        size_t pair = 0;
+        for (size_t j = 0; j < m; j++) {
+            // Point-to-point matching
+            double dist_ij = (b[j] - rotated).squaredNorm();
+
+            if (dist_ij < closest) {
+                second_closest = closest;
+                closest = dist_ij;
+                pair = j;
+            } else if (dist_ij < second_closest) {
+                second_closest = dist_ij;
+            }
+        }
+        matches[i].pair = pair;
+        matches[i].sq_dist = closest;
+        distance_evaluations += m;
+
+        if (lazy_matching) {
+            lazy_position[i] = rotated;
+            lazy_pair[i] = pair;
+            lazy_margin[i] = (std::sqrt(second_closest) - std::sqrt(closest))
+                             / 2;
+        }
+    }
+
+    bool ICP::step(size_t max_points) {
+        if (!matches_by_point()) {
+            iterate();
+            return true;
+        }
+
+        // Match the next slice from the transform the iteration starts at
+        const size_t n = a.size();
+        matches.resize(n);
+        if (step_progress < n) {
+            Timeline::Span span("match");
+            const size_t end = step_progress
+                               + std::min(std::max<size_t>(max_points, 1),
+                                   n - step_progress);
+            for (size_t i = step_progress; i < end; i++) {
+                match_point(i, transform.rotation * a[i]);
+            }
+            step_progress = end;
+            if (step_progress < n) {
+                return false;
+            }
+        }
+
+        step_progress = 0;
+        has_stepped_matches = true;
+        iterate();
+        has_stepped_matches = false;
+        return true;
+    }
+
+    void ICP::sort_along_curve(std::vector<Vector>& points,
+        std::vector<size_t>& order) {
+        const size_t n = points.size();
+        if (n == 0) {
+            order.clear();
+            return;
+        }
+
+        // Quantize the bounding box onto the grid the curve passes through
+        Vector min = points[0];
+        Vector max = points[0];
+        for (const Vector& point: points) {
+            min = min.cwiseMin(point);
+            max = max.cwiseMax(point);
+        }
+        const double extent = (max - min).maxCoeff();
+        const double scale = extent > 0 ? UINT16_MAX / extent : 0;
+
+        curve_keys.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            const uint16_t x = (points[i].x() - min.x()) * scale;
+            const uint16_t y = (points[i].y() - min.y()) * scale;
+            const uint32_t position = spatial_order == SpatialOrder::hilbert
+                                          ? hilbert_index(x, y)
+                                          : morton_index(x, y);
+            curve_keys[i] = (uint64_t)position << 32 | i;
+        }
+        std::sort(curve_keys.begin(), curve_keys.end());
+
+        order.resize(n);
+        reordered.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            order[i] = curve_keys[i] & UINT32_MAX;
+            reordered[i] = points[order[i]];
+        }
+        points.swap(reordered);
+    }
+
+    size_t ICP::source_index(size_t i) const {
+        if (!sample.empty()) {
+            i = sample[i];
+        }
+        return a_order.empty() ? i : a_order[i];
+    }
+
+    size_t ICP::scheduled_sample_size(size_t iteration) const {
+        const size_t n = whole_a.size();
+        const double fraction = sample_fraction
+                                * std::pow(sample_growth, (double)iteration);
+        if (fraction >= 1 || n == 0) {
+            return n;
+        }
+        return std::clamp((size_t)std::ceil(fraction * n), (size_t)1, n);
+    }
+
+    void ICP::draw_sample(size_t size) {
+        const size_t n = whole_a.size();
+        if (size == n && sample.empty()) {
+            return;
+        }
+
+        if (size == n) {
+            // The sample's matches stand until every point is matched, so
+            // move each to its point, working backward to do so in place
+            const size_t matched = matched_count;
+            matches.resize(n);
+            for (size_t i = n, k = matched; i-- > 0;) {
+                if (k > 0 && sample[k - 1] == i) {
+                    matches[i] = matches[--k];
+                } else {
+                    matches[i] = Match{0,
+                        std::numeric_limits<MatchDistance>::infinity()};
+                }
+            }
+
+            // Rank the points left unmatched last, so that they are not
+            // mistaken for correspondences
+            if (ranked_matches.empty()) {
+                ranked_matches.resize(sample.size());
+                std::iota(ranked_matches.begin(), ranked_matches.end(), 0);
+                inlier_count = matched;
+            }
+            for (MatchIndex& i: ranked_matches) {
+                i = sample[i];
+            }
+            for (size_t i = 0, k = 0; i < n; i++) {
+                if (k < sample.size() && sample[k] == i) {
+                    k++;
+                } else {
+                    ranked_matches.push_back(i);
+                }
+            }
+            a = whole_a;
+            sample.clear();
+        } else {
+            // One point from each of `size` equal runs of the cloud
+            const double offset = std::uniform_real_distribution<double>(0,
+                1)(sampler);
+            a.resize(size);
+            sample.resize(size);
+            for (size_t j = 0; j < size; j++) {
+                sample[j] = std::min((size_t)((j + offset) * n / size), n - 1);
+                a[j] = whole_a[sample[j]];
+            }
+            matches.resize(size);
+            ranked_matches.clear();
+            matched_count = 0;
+            inlier_sums = InlierSums();
+        }
+
+        // Every index now refers to a different point
+        if (lazy_matching) {
+            lazy_margin.assign(size, -1);
+        }
+        setup();
+    }
+
+    size_t ICP::destination_index(size_t j) const {
+        return b_order.empty() ? j : b_order[j];
     }
 
     double ICP::calculate_cost() const {
@@ -52,36 +368,170 @@ namespace icp {
         for (auto& match: matches) {
             sum_squares += match.sq_dist;
         }
-        return std::sqrt(sum_squares / a.size());
+        return std::sqrt(sum_squares / matches.size());
+    }
+
+    bool ICP::has_budget_for(size_t evaluations, bool check_clock) {
+        if (distance_evaluations + evaluations > evaluation_limit) {
+            interruption = StopReason::out_of_evaluations;
+            return false;
+        }
+        if (check_clock && Budget::Clock::now() >= deadline) {
+            interruption = StopReason::out_of_time;
+            return false;
+        }
+        return true;
     }
 
     ICP::ConvergenceReport ICP::converge(size_t burn_in,
         double convergence_threshold) {
+        return converge(burn_in, convergence_threshold, Budget());
+    }
+
+    ICP::ConvergenceReport ICP::converge(size_t burn_in,
+        double convergence_threshold, const Budget& budget) {
         ConvergenceReport result{};
+        result.stop_reason = StopReason::converged;
+
+        const size_t initial_evaluations = distance_evaluations;
+        deadline = budget.deadline;
+        evaluation_limit = initial_evaluations
+                           + std::min(budget.max_distance_evaluations,
+                               std::numeric_limits<size_t>::max()
+                                   - initial_evaluations);
+        is_budgeted = deadline != Budget::Clock::time_point::max()
+                      || evaluation_limit
+                             != std::numeric_limits<size_t>::max();
+        is_interrupted = false;
+
+        // The cost measured in an iteration is that of the transform it
+        // started from
+        double best_cost = std::numeric_limits<double>::infinity();
+        RBTransform best_transform = transform;
+
+        // Costs are only comparable between samples of the same size
+        const bool is_sampling = sample_fraction < 1;
+        size_t sample_size = 0;
+
+        // When accelerating, `transform` may be an extrapolation, in which
+        // case `plain_transform` is the unaccelerated step it replaced
+        Anderson anderson(anderson_depth);
+        bool is_extrapolated = false;
+        RBTransform plain_transform;
 
         // Repeat until convergence
         while (current_cost > convergence_threshold || current_cost == INFINITY
-               || result.iteration_count < burn_in) {
+               || result.iteration_count < burn_in || !sample.empty()) {
+            if (result.iteration_count >= budget.max_iterations) {
+                result.stop_reason = StopReason::out_of_iterations;
+                break;
+            }
+            if (is_budgeted && !has_budget_for(0)) {
+                result.stop_reason = interruption;
+                break;
+            }
+
             // Store previous iteration results
             previous_cost = current_cost;
             RBTransform previous_transform = transform;
+            if (is_sampling) {
+                // A sample that already looks converged is checked against
+                // every point straight away
+                size_t size = std::max(sample_size,
+                    scheduled_sample_size(result.iteration_count));
+                if (current_cost <= convergence_threshold
+                    && result.iteration_count >= burn_in) {
+                    size = whole_a.size();
+                }
+                if (size != sample_size) {
+                    sample_size = size;
+                    previous_cost = std::numeric_limits<double>::infinity();
+                    best_cost = std::numeric_limits<double>::infinity();
+                }
+                draw_sample(size);
+            }
 
+            Timeline::Span phase("iterate");
             iterate();
 
+            // Discard an iteration cut short by the budget
+            if (is_interrupted) {
+                transform = previous_transform;
+                result.stop_reason = interruption;
+                break;
+            }
+
             // If cost rose, revert to previous transformation/cost and
             // exit
+            phase.next("cost");
             current_cost = calculate_cost();
+            phase.next("decide");
+            if (current_cost < best_cost) {
+                best_cost = current_cost;
+                best_transform = previous_transform;
+            }
             if (current_cost >= previous_cost
                 && result.iteration_count > burn_in) {
-                transform = previous_transform;
                 current_cost = previous_cost;
+
+                // Unless it was the extrapolation that failed, in which case
+                // retry with the plain step instead
+                if (is_extrapolated) {
+                    transform = plain_transform;
+                    is_extrapolated = false;
+                    anderson.clear();
+                    result.iteration_count++;
+                    continue;
+                }
+
+                // Nor does a sample, which is only rough, so move on to the
+                // next until every point is used
+                if (!sample.empty()) {
+                    transform = previous_transform;
+                    result.iteration_count++;
+                    continue;
+                }
+
+                transform = previous_transform;
                 break;
             }
 
+            if (trace) {
+                record_iteration(previous_transform);
+            }
+
             result.iteration_count++;
+
+            if (anderson_depth > 0) {
+                plain_transform = transform;
+                transform = anderson.extrapolate(previous_transform,
+                    plain_transform);
+                is_extrapolated = true;
+            }
+        }
+
+        // Never finish on an extrapolation whose cost was not checked
+        if (is_extrapolated) {
+            transform = plain_transform;
+        }
+
+        // Stopped early while the cost was not improving, such as during
+        // the burn-in, so fall back to the best transform measured
+        if (result.stop_reason != StopReason::converged
+            && current_cost > best_cost) {
+            transform = best_transform;
+            current_cost = best_cost;
         }
 
+        // Leave every point in place for whatever comes next
+        if (is_sampling) {
+            draw_sample(whole_a.size());
+        }
+
+        is_budgeted = false;
         result.final_cost = current_cost;
+        result.distance_evaluations = distance_evaluations
+                                      - initial_evaluations;
 
         return result;
     }
@@ -90,6 +540,123 @@ namespace icp {
         return transform;
     }
 
+    size_t ICP::Correspondences::size() const {
+        return icp.matched_count;
+    }
+
+    ICP::Correspondence ICP::Correspondences::operator[](size_t k) const {
+        const size_t i = icp.ranked_match(k);
+        return Correspondence{icp.source_index(i),
+            icp.destination_index(icp.matches[i].pair),
+            std::sqrt(icp.matches[i].sq_dist), icp.is_inlier(k)};
+    }
+
+    size_t ICP::ranked_match(size_t k) const {
+        return ranked_matches.empty() ? k : ranked_matches[k];
+    }
+
+    bool ICP::is_inlier(size_t k) const {
+        return (ranked_matches.empty() || k < inlier_count)
+               && std::isfinite(matches[ranked_match(k)].sq_dist);
+    }
+
+    ICP::Correspondences ICP::correspondences() const {
+        return Correspondences(*this);
+    }
+
+    Eigen::Matrix3d ICP::covariance() const {
+        // Each residual `R p + t - q` changes with the translation as the
+        // identity and with the angle as `R p` turned a quarter, so `H`
+        // needs only the sums of `p` and its squared norm
+        if (inlier_sums.count < 4) {
+            return Eigen::Matrix3d::Constant(
+                std::numeric_limits<double>::infinity());
+        }
+        const double count = (double)inlier_sums.count;
+        const Vector rotated = transform.rotation * inlier_sums.points;
+        Eigen::Matrix3d hessian;
+        hessian << count, 0, -rotated.y(), 0, count, rotated.x(),
+            -rotated.y(), rotated.x(), inlier_sums.squared_norms;
+
+        // Three degrees of freedom were fit to the residuals
+        return inlier_sums.squared_distances / (count - 3) * hessian.inverse();
+    }
+
+    const DistanceField* ICP::matching_field() const {
+        return distance_field.get();
+    }
+
+    ICP::MemoryUsage ICP::memory_usage() const {
+        MemoryUsage usage;
+        usage.points = (a.capacity() + b.capacity() + whole_a.capacity()
+                           + reordered.capacity())
+                           * sizeof(Vector)
+                       + (a_order.capacity() + b_order.capacity()
+                             + sample.capacity())
+                             * sizeof(size_t)
+                       + curve_keys.capacity() * sizeof(uint64_t);
+        usage.matches = matches.capacity() * sizeof(Match)
+                        + ranked_matches.capacity() * sizeof(MatchIndex)
+                        + lazy_position.capacity() * sizeof(Vector)
+                        + lazy_pair.capacity() * sizeof(size_t)
+                        + lazy_margin.capacity() * sizeof(double);
+        usage.distance_field = distance_field ? distance_field->memory_usage()
+                                              : 0;
+        usage.method = method_memory_usage();
+        return usage;
+    }
+
+    void ICP::configure(const Config& config) {
+        lazy_matching = config.get<int>("lazy_matching", 0);
+        anderson_depth = std::max(config.get<int>("anderson_depth", 0), 0);
+        if (lazy_matching) {
+            reserve_points(lazy_position);
+            reserve_points(lazy_pair);
+            reserve_points(lazy_margin);
+        }
+        const std::string order = config.get<std::string>("spatial_order",
+            "none");
+        if (order == "morton") {
+            spatial_order = SpatialOrder::morton;
+        } else if (order == "hilbert") {
+            spatial_order = SpatialOrder::hilbert;
+        }
+        sample_fraction = config.get<double>("sample_fraction", 1.0);
+        sample_growth = config.get<double>("sample_growth", 2.0);
+        if (!(sample_fraction > 0) || !(sample_growth > 1)) {
+            sample_fraction = 1;
+        }
+        if (sample_fraction < 1) {
+            reserve_points(whole_a);
+            reserve_points(sample);
+        }
+        if (spatial_order != SpatialOrder::none) {
+            reserve_points(a_order);
+            reserve_points(b_order);
+            reserve_points(curve_keys);
+            reserve_points(reordered);
+        }
+        if (config.get<int>("distance_field", 0)) {
+            distance_field = std::make_unique<DistanceField>(
+                config.get<double>("field_resolution", 10.0),
+                config.get<double>("field_margin", 100.0));
+            field_cache = config.get<std::string>("field_cache", "");
+        }
+    }
+
+    void ICP::record(IterationTrace* trace) {
+        this->trace = trace;
+    }
+
+    void ICP::record_iteration(const RBTransform& start) {
+        uint32_t* pairs = trace->add_frame(transform, start, current_cost);
+        if (pairs) {
+            for (size_t i = 0; i < matches.size(); i++) {
+                pairs[source_index(i)] = destination_index(matches[i].pair);
+            }
+        }
+    }
+
     static void ensure_methods_exists() {
         if (!global) {
             global = new Methods();
@@ -115,7 +682,10 @@ namespace icp {
         size_t index = std::find(global->registered_method_names.begin(),
                            global->registered_method_names.end(), name)
                        - global->registered_method_names.begin();
-        return global->registered_method_constructors[index](config);
+        std::unique_ptr<ICP> instance =
+            global->registered_method_constructors[index](config);
+        instance->configure(config);
+        return instance;
     }
 
     bool ICP::is_registered_method(std::string name) {
@@ -6,14 +6,22 @@
 #pragma once
 
 #include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <memory>
+#include <random>
 #include <string>
 #include <functional>
 #include <unordered_map>
+#include <variant>
 #include "geo.h"
+#include "distance_field.h"
 
 namespace icp {
+    class IterationTrace;
+
     /**
      * Interface for iterative closest points.
      * You should interact with ICP instances through this API only.
@@ -43,13 +51,26 @@ namespace icp {
      */
     class ICP {
     protected:
+#ifdef ICP_COMPACT_MATCHES
+        /** The type of point indices stored in ICP::Match. */
+        using MatchIndex = uint32_t;
+
+        /** The type of squared distances stored in ICP::Match. */
+        using MatchDistance = float;
+#else
+        using MatchIndex = size_t;
+        using MatchDistance = double;
+#endif
+
         // TODO: make this more general to allow for point-to-line
-        /** A point-to-point matching between `point` and `pair` at a distance
-         * of `sqrt(sq_dist)`.  */
+        /** A point-to-point matching of the point in `a` at the same index
+         * as this match in `matches` to `pair` at a distance of
+         * `sqrt(sq_dist)`. Defining the macro `ICP_COMPACT_MATCHES`, e.g.,
+         * with `make COMPACT_MATCHES=1`, halves its size to 8 bytes at the
+         * cost of limiting the point clouds to `UINT32_MAX` points. */
         struct Match {
-            size_t point;
-            size_t pair;
-            double sq_dist;
+            MatchIndex pair;
+            MatchDistance sq_dist;
         };
 
         /** The current point cloud transformation that is being optimized.
@@ -62,7 +83,9 @@ namespace icp {
         /** The centroid of the destination point cloud. */
         Vector b_cm;
 
-        /** The source point cloud relative to its centroid. */
+        /** The source point cloud relative to its centroid, or during
+         * ICP::converge with the `"sample_fraction"` parameter set, the
+         * sample of it being matched this iteration. */
         std::vector<Vector> a;
 
         /** The destination point cloud relative to its centroid. */
@@ -75,14 +98,177 @@ namespace icp {
         /** The RMS (root mean square) cost of the current transformation. */
         double current_cost;
 
-        /** The pairing of each point in `a` to its closest in `b`. */
+        /** The pairing of each point in `a` to its closest in `b`. A point
+         * that has not been matched has an infinite `sq_dist`. */
         std::vector<Match> matches;
 
+        /** The indices of `matches` in the order the last transformation
+         * step considered them, of which it used the first `inlier_count`,
+         * or empty if it used every match. Methods that discard matches
+         * must fill both every iteration. @see ICP::correspondences. */
+        std::vector<MatchIndex> ranked_matches;
+
+        /** How many of `ranked_matches` the last transformation step used.
+         */
+        size_t inlier_count;
+
+        /** How many matches, taken in the order of `ranked_matches` if it is
+         * not empty, were found by the last iteration. The rest were never
+         * matched, and come after every match that was. */
+        size_t matched_count;
+
+        /** Sums over the inliers of the last transformation step, from
+         * which ICP::covariance is computed without another pass. */
+        struct InlierSums {
+            size_t count = 0;
+
+            /** The sum of the inlier source points, before centering. */
+            Vector points = Vector::Zero();
+            double squared_norms = 0;
+            double squared_distances = 0;
+        };
+        InlierSums inlier_sums;
+
+        /** The index in the source point cloud given to ICP::begin of each
+         * point in `a`, or empty if `a` is in its original order. See the
+         * `"spatial_order"` parameter of ICP::from_method. */
+        std::vector<size_t> a_order;
+
+        /** The index in the destination point cloud given to ICP::begin of
+         * each point in `b`, or empty if `b` is in its original order. */
+        std::vector<size_t> b_order;
+
+        /** Where iterations are recorded, if anywhere. @see ICP::record. */
+        IterationTrace* trace;
+
+        /** Whether ICP::compute_matches may reuse previous matches. */
+        bool lazy_matching;
+
+        /** How many previous iterates ICP::converge extrapolates from, or
+         * zero to iterate plainly. */
+        size_t anderson_depth;
+
+        /** The precomputed nearest points of `b` used by
+         * ICP::compute_matches, if the `"distance_field"` parameter is set.
+         */
+        std::unique_ptr<DistanceField> distance_field;
+
+        /** The number of point distances computed since ICP::begin. Methods
+         * that do not match through ICP::compute_matches must count their
+         * own. */
+        size_t distance_evaluations;
+
+        /** For each point in `a`, its rotated position when it was last
+         * searched for. */
+        std::vector<Vector> lazy_position;
+
+        /** For each point in `a`, its closest point in `b` when it was last
+         * searched for. */
+        std::vector<size_t> lazy_pair;
+
+        /** For each point in `a`, how far it may move from `lazy_position`
+         * before `lazy_pair` might no longer be its closest point. Negative
+         * if it must be searched for. */
+        std::vector<double> lazy_margin;
+
         ICP();
 
+        /** Reserves room for ICP::max_points elements in `buffer` if the
+         * point count is bounded, so that sizing it to a point cloud never
+         * allocates. Methods should call this on their own per-point
+         * buffers when constructed. */
+        template<typename T>
+        static void reserve_points(std::vector<T>& buffer) {
+            if (max_points != std::numeric_limits<size_t>::max()) {
+                buffer.reserve(max_points);
+            }
+        }
+
         virtual void setup();
 
+        /** The number of bytes of heap memory held by the buffers of the
+         * method itself. @see ICP::memory_usage. */
+        virtual size_t method_memory_usage() const;
+
+        /**
+         * Matches each point `a_rot[i]`, the point `a[i]` rotated by
+         * `transform.rotation`, to its closest point in `b`, storing the
+         * result in `matches[i]`.
+         *
+         * When the `"lazy_matching"` parameter is set, a point whose closest
+         * and second closest points were `d1` and `d2` away when last
+         * searched keeps its match without a search while it has moved less
+         * than `(d2 - d1) / 2`, since no other point can have become closer.
+         * The result is identical to a full search.
+         *
+         * When the `"distance_field"` parameter is set, each point is
+         * instead looked up in a DistanceField of `b`, which is also exact
+         * and takes precedence over lazy matching.
+         *
+         * When called during a bounded ICP::converge that runs out of time
+         * or distance evaluations, the search stops early and the
+         * iteration is discarded.
+         *
+         * When ICP::step has already matched every point for this
+         * iteration, this does nothing.
+         *
+         * \par Efficiency:
+         * `O(a.size() * b.size())` for the points that are searched, or
+         * about `O(a.size())` with a distance field.
+         */
+        void compute_matches(const std::vector<Vector>& a_rot);
+
+        /** Appends the current transform to `trace`, along with the
+         * transform `start` the iteration began at and the cost and matches
+         * measured there. */
+        void record_iteration(const RBTransform& start);
+
+        /** The index of `a[i]` in the source point cloud given to
+         * ICP::begin, which accounts for sampling and sorting. */
+        size_t source_index(size_t i) const;
+
+        /** The index of `b[j]` in the destination point cloud given to
+         * ICP::begin. */
+        size_t destination_index(size_t j) const;
+
+        /** The index in `matches` of the `k`th correspondence in the order
+         * the last transformation step considered them. */
+        size_t ranked_match(size_t k) const;
+
+        /** Whether the last transformation step used the `k`th
+         * correspondence in that order. */
+        bool is_inlier(size_t k) const;
+
+        /** Adds `matches[i]` to `inlier_sums` if it was matched. Methods
+         * must call this for each match their transformation step uses. */
+        void add_inlier(size_t i) {
+            const double sq_dist = matches[i].sq_dist;
+            if (std::isfinite(sq_dist)) {
+                const Vector point = a[i] + a_cm;
+                inlier_sums.count++;
+                inlier_sums.points += point;
+                inlier_sums.squared_norms += point.squaredNorm();
+                inlier_sums.squared_distances += sq_dist;
+            }
+        }
+
     public:
+        /** Why ICP::converge stopped. */
+        enum class StopReason {
+            /** The cost fell below the threshold or stopped decreasing. */
+            converged,
+
+            /** The deadline of the ICP::Budget passed. */
+            out_of_time,
+
+            /** The iteration limit of the ICP::Budget was reached. */
+            out_of_iterations,
+
+            /** The distance evaluation limit of the ICP::Budget was
+             * reached. */
+            out_of_evaluations
+        };
+
         /** The result of running `ICP::converge`. */
         struct ConvergenceReport {
             /** The least cost achieved. */
@@ -91,6 +277,61 @@ namespace icp {
             /** The number of iterations performed, including the burn-in
              * period. */
             size_t iteration_count;
+
+            /** Whether the transform converged or the budget ran out first.
+             */
+            StopReason stop_reason;
+
+            /** The number of point distances computed. */
+            size_t distance_evaluations;
+        };
+
+        /** The heap memory held by an ICP instance, in bytes, counting the
+         * capacity of its buffers. */
+        struct MemoryUsage {
+            /** The copies of the point clouds, including any sorted or
+             * sampled ones. */
+            size_t points;
+
+            /** The matches and the state kept for lazy matching. */
+            size_t matches;
+
+            /** The distance field, if any. */
+            size_t distance_field;
+
+            /** The buffers of the method itself, such as the rotated
+             * source points. */
+            size_t method;
+
+            /** The sum of the above. */
+            size_t total() const {
+                return points + matches + distance_field + method;
+            }
+        };
+
+        /** Limits on the work done by ICP::converge. Every limit is
+         * unbounded by default. */
+        struct Budget {
+            using Clock = std::chrono::steady_clock;
+
+            /** The time by which ICP::converge must return. */
+            Clock::time_point deadline = Clock::time_point::max();
+
+            /** The most iterations to perform. */
+            size_t max_iterations = std::numeric_limits<size_t>::max();
+
+            /** The most point distances to compute. Matching with a
+             * DistanceField may exceed this by the few distances needed for
+             * one source point. */
+            size_t max_distance_evaluations =
+                std::numeric_limits<size_t>::max();
+
+            /** A budget with a deadline `duration` from now. */
+            static Budget within(Clock::duration duration) {
+                Budget budget;
+                budget.deadline = Clock::now() + duration;
+                return budget;
+            }
         };
 
         /** Configuration for ICP instances. */
@@ -120,11 +361,31 @@ namespace icp {
             }
         };
 
+        /**
+         * The most points ICP::begin accepts in either point cloud, which is
+         * unbounded unless the macro `ICP_MAX_POINTS` is defined, e.g., with
+         * `make MAX_POINTS=2048`.
+         *
+         * When bounded, the buffers sized by the point clouds are allocated
+         * for this many points when an instance is constructed, so that
+         * ICP::begin and ICP::converge perform no heap allocation. This
+         * holds for every method without recording or a distance field.
+         */
+#ifdef ICP_MAX_POINTS
+        static constexpr size_t max_points = ICP_MAX_POINTS;
+#else
+        static constexpr size_t max_points = std::numeric_limits<size_t>::max();
+#endif
+
         virtual ~ICP() = default;
 
         /** Begins the ICP process for point clouds `a` and `b` with an initial
-         * guess for the transform `t`. */
-        void begin(const std::vector<Vector>& a, const std::vector<Vector>& b,
+         * guess for the transform `t`.
+         *
+         * @returns `false`, leaving the instance unchanged, if either point
+         * cloud has more than ICP::max_points points, or more than
+         * `UINT32_MAX` with `ICP_COMPACT_MATCHES` defined. */
+        bool begin(const std::vector<Vector>& a, const std::vector<Vector>& b,
             RBTransform t);
 
         /** Perform one iteration of ICP for the point clouds `a` and `b`
@@ -133,6 +394,30 @@ namespace icp {
          * @pre ICP::begin must have been invoked. */
         virtual void iterate() = 0;
 
+        /**
+         * Performs a bounded slice of ICP::iterate, matching up to
+         * `max_points` more source points (at least one) and, once every
+         * point is matched, finishing the iteration. Calling this until it
+         * returns `true` has the same result as one call to ICP::iterate,
+         * so a single thread can interleave several instances with other
+         * work. Progress is kept until the iteration finishes or
+         * ICP::begin is called.
+         *
+         * Methods that do not match through ICP::compute_matches, such as
+         * \ref ndt_icp, perform the whole iteration in one step.
+         *
+         * \par Example
+         * @code
+         * while (!icp->step(256)) {
+         *     poll_sensors();
+         * }
+         * @endcode
+         *
+         * @returns Whether the iteration finished.
+         * @pre ICP::begin must have been invoked.
+         */
+        bool step(size_t max_points);
+
         /**
          * Computes the cost of the current transformation.
          *
@@ -148,15 +433,165 @@ namespace icp {
          * with zero burn-in, and slowly increase if convergence requirements
          * are not met.
          *
+         * If the `"anderson_depth"` parameter was given, each new transform
+         * is extrapolated from the previous iterates, and an extrapolation
+         * that raises the cost is replaced by the plain step. The iterations
+         * spent on rejected extrapolations are included in the count.
+         *
          * @returns Information about the convergence.
          * @pre ICP::begin must have been invoked.
          */
         ConvergenceReport converge(size_t burn_in,
             double convergence_threshold);
 
+        /**
+         * Performs ICP::converge until `budget` runs out, whichever happens
+         * first, returning the best transform found so far. The budget
+         * takes precedence over `burn_in`.
+         *
+         * The deadline is checked before every iteration and, for methods
+         * matching with ICP::compute_matches, every few points during
+         * matching, where an interrupted iteration is discarded. It is
+         * therefore overrun by at most a small fraction of an iteration.
+         *
+         * \par Example
+         * @code
+         * // Leave the control loop 10 ms
+         * icp->converge(0, 1,
+         *     icp::ICP::Budget::within(std::chrono::milliseconds(10)));
+         * @endcode
+         *
+         * @pre ICP::begin must have been invoked.
+         */
+        ConvergenceReport converge(size_t burn_in,
+            double convergence_threshold, const Budget& budget);
+
+        /** A pairing of a source point to its closest destination point
+         * made by the last iteration. */
+        struct Correspondence {
+            /** The index of the source point in the point cloud given to
+             * ICP::begin. */
+            size_t source;
+
+            /** The index of the destination point in the point cloud given
+             * to ICP::begin. */
+            size_t destination;
+
+            /** The distance between them when they were matched. */
+            double residual;
+
+            /** Whether the last transformation step used this pairing,
+             * which is always the case unless the method discards some,
+             * such as \ref trimmed_icp. */
+            bool is_inlier;
+        };
+
+        /** A read-only view of the correspondences made by the last
+         * iteration, which reads them in place and is invalidated by the
+         * next call to ICP::begin, ICP::iterate, ICP::step, or
+         * ICP::converge. */
+        class Correspondences {
+        public:
+            /** Iterates over the correspondences in the view. */
+            class Iterator {
+            public:
+                Correspondence operator*() const {
+                    return (*view)[k];
+                }
+                Iterator& operator++() {
+                    k++;
+                    return *this;
+                }
+                bool operator!=(const Iterator& other) const {
+                    return k != other.k;
+                }
+
+            private:
+                friend class Correspondences;
+                Iterator(const Correspondences* view, size_t k)
+                    : view(view), k(k) {}
+                const Correspondences* view;
+                size_t k;
+            };
+
+            /** The number of correspondences. */
+            size_t size() const;
+
+            /** The `k`th correspondence, in no particular order. */
+            Correspondence operator[](size_t k) const;
+
+            Iterator begin() const {
+                return Iterator(this, 0);
+            }
+            Iterator end() const {
+                return Iterator(this, size());
+            }
+
+        private:
+            friend class ICP;
+            Correspondences(const ICP& icp): icp(icp) {}
+            const ICP& icp;
+        };
+
         /** The current transform. */
         const RBTransform& current_transform() const;
 
+        /**
+         * The correspondences made by the last iteration, from the
+         * transform it started at, which ICP::converge has found for every
+         * point unless its budget interrupted the last iteration or a
+         * sample. Points left unmatched are not listed.
+         *
+         * \par Example
+         * @code
+         * for (icp::ICP::Correspondence pairing: icp->correspondences()) {
+         *     if (pairing.is_inlier) {
+         *         residuals[pairing.source] = pairing.residual;
+         *     }
+         * }
+         * @endcode
+         *
+         * @pre An iteration must have been performed since ICP::begin.
+         */
+        Correspondences correspondences() const;
+
+        /**
+         * The covariance of the translation and rotation angle of the
+         * current transform, in that order, estimated from the inlier
+         * correspondences of the last iteration as `s^2 H^-1`. Here `H` is
+         * the Gauss-Newton approximation of the Hessian of the squared
+         * point-to-point residuals and `s^2` is their variance, so the
+         * estimate is only as good as the correspondences. All entries are
+         * infinite with fewer than four inliers.
+         *
+         * \par Efficiency:
+         * `O(1)`, as the transformation step sums what it needs while
+         * visiting the inliers.
+         *
+         * @pre An iteration must have been performed since ICP::begin.
+         */
+        Eigen::Matrix3d covariance() const;
+
+        /** The distance field used for matching, or `nullptr` if matching
+         * searches `b` directly. */
+        const DistanceField* matching_field() const;
+
+        /** Whether ICP::iterate matches the source points through
+         * ICP::compute_matches, so that ICP::step may match them ahead of
+         * time in slices and `"lazy_matching"` applies. Methods that match
+         * otherwise must return `false`.
+         */
+        virtual bool matches_by_point() const;
+
+        /** The heap memory currently held by this instance. */
+        MemoryUsage memory_usage() const;
+
+        /** Records the point clouds given to subsequent calls of ICP::begin
+         * and every iteration performed by ICP::converge into `trace`. Pass
+         * `nullptr` to stop recording. The trace must outlive its use by
+         * this instance. */
+        void record(IterationTrace* trace);
+
         /** Registers a new ICP method that can be created with `constructor`,
          * returning `false` if `name` has already been registered. */
         static bool register_method(std::string name,
@@ -170,6 +605,48 @@ namespace icp {
          * Factory constructor for the ICP method `name` with configuration
          * `config`.
          *
+         * Besides the parameters documented by each method, every method
+         * accepts the following:
+         * - `"lazy_matching"`: An `int` which, when nonzero, skips the
+         * search for points whose match provably cannot have changed. See
+         * ICP::compute_matches. The default is `0`.
+         * - `"anderson_depth"`: A nonnegative `int` which, when nonzero, makes
+         * ICP::converge extrapolate each transform from that many previous
+         * iterates by Anderson acceleration, falling back to the plain step
+         * whenever the cost rises. The default is `0`.
+         * - `"distance_field"`: An `int` which, when nonzero, precomputes a
+         * DistanceField of the destination in ICP::begin to match against.
+         * It is only rebuilt when the destination changes, so this pays off
+         * when matching many sources against the same destination. The
+         * default is `0`.
+         * - `"field_resolution"`: A positive `double` for the side length of
+         * a distance field cell, in the units of the point clouds. The
+         * default is `10.0`.
+         * - `"field_margin"`: A nonnegative `double` for how far the distance
+         * field extends beyond the destination. Source points outside are
+         * still matched exactly, but more slowly. The default is `100.0`.
+         * - `"field_cache"`: A `std::string` naming an existing directory in
+         * which ICP::begin saves each distance field it builds, and from
+         * which it loads them again for the same destination, e.g., across
+         * restarts. See DistanceField::build_cached. The default is `""`,
+         * which always builds the field.
+         * - `"sample_fraction"`: A `double` in `(0, 1]` for the fraction of
+         * the source points matched by the first iteration of
+         * ICP::converge. The default is `1.0`, which matches every point.
+         * Smaller values start from an evenly spread sample, redrawn at
+         * random every iteration, so early iterations cost less. The cost
+         * is only compared between iterations using the same number of
+         * points, and ICP::converge only finishes after using every point,
+         * which it skips ahead to once a sample meets the threshold.
+         * - `"sample_growth"`: A `double` greater than `1` by which the
+         * sample grows each iteration. The default is `2.0`.
+         * - `"spatial_order"`: A `std::string`, either `"morton"` or
+         * `"hilbert"`, which makes ICP::begin sort both point clouds along
+         * that space-filling curve so that nearby points are nearby in
+         * memory, which speeds up matching large point clouds. Recorded
+         * matches still refer to the points in the order given. Any other
+         * value, such as the default `"none"`, keeps that order.
+         *
          * @pre `name` is a valid registered method. See
          * ICP::is_registered_method.
          */
@@ -178,6 +655,85 @@ namespace icp {
 
         /** Whether `name` is a registered ICP method. */
         static bool is_registered_method(std::string name);
+
+    private:
+        /** Whether ICP::compute_matches must check the budget. */
+        bool is_budgeted;
+
+        /** When ICP::compute_matches must stop. */
+        Budget::Clock::time_point deadline;
+
+        /** The value of `distance_evaluations` at which
+         * ICP::compute_matches must stop. */
+        size_t evaluation_limit;
+
+        /** How many source points ICP::step has matched for the next
+         * iteration. */
+        size_t step_progress;
+
+        /** Whether ICP::step has matched every source point for the
+         * iteration ICP::iterate is performing. */
+        bool has_stepped_matches;
+
+        /** Matches `a[i]`, whose position rotated by `transform.rotation` is
+         * `rotated`, as described in ICP::compute_matches. */
+        void match_point(size_t i, const Vector& rotated);
+
+        /** Why ICP::compute_matches stopped early, if it did. */
+        bool is_interrupted;
+        StopReason interruption;
+
+        /** Whether the budget allows `evaluations` more distance
+         * evaluations and, if `check_clock`, has time left, setting
+         * `interruption` if not. */
+        bool has_budget_for(size_t evaluations, bool check_clock = true);
+
+        /** The fraction of the source points sampled by the first iteration
+         * of ICP::converge. */
+        double sample_fraction;
+
+        /** The factor by which the sample grows each iteration. */
+        double sample_growth;
+
+        /** The whole of `a` while it holds a sample. */
+        std::vector<Vector> whole_a;
+
+        /** The index in `whole_a` of each point in `a`, or empty if `a` is
+         * not a sample. */
+        std::vector<size_t> sample;
+
+        /** Where samples are drawn from. */
+        std::minstd_rand sampler;
+
+        /** The size of the sample that iteration `iteration` matches. */
+        size_t scheduled_sample_size(size_t iteration) const;
+
+        /** Replaces `a` with an evenly spread sample of `size` points of
+         * `whole_a`, at a random offset, or with all of it. */
+        void draw_sample(size_t size);
+
+        /** Where distance fields are saved to and loaded from, or empty if
+         * they are always built. */
+        std::string field_cache;
+
+        /** The space-filling curve ICP::begin sorts the point clouds along.
+         */
+        enum class SpatialOrder { none, morton, hilbert } spatial_order;
+
+        /** The curve position and original index of each point being
+         * sorted, packed so that sorting them sorts the points. */
+        std::vector<uint64_t> curve_keys;
+
+        /** Storage for a point cloud while it is permuted. */
+        std::vector<Vector> reordered;
+
+        /** Sorts `points` along `spatial_order`, storing in `order[i]` the
+         * index the `i`th point had before. */
+        void sort_along_curve(std::vector<Vector>& points,
+            std::vector<size_t>& order);
+
+        /** Reads the parameters common to all methods from `config`. */
+        void configure(const Config& config);
     };
 
     struct Methods {
@@ -0,0 +1,462 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include "../icp.h"
+#include "../timeline.h"
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include <Eigen/LU>
+
+/* #name NDT */
+
+/* #desc The normal distributions transform (NDT) does not search for
+correspondences. Instead, the destination point cloud is summarized once by a
+grid of normal distributions, and the transform is optimized by Newton's method
+on the likelihood of the transformed source points under those distributions.
+Looking up the distribution for a source point takes constant time. */
+
+namespace icp {
+    struct NDT final : public ICP {
+        /** A normal distribution summarizing the points in one cell, which
+         * are `cell_points[start]` through `cell_points[start + count - 1]`
+         * of its grid. */
+        struct Cell {
+            long x;
+            long y;
+            size_t start;
+            size_t count;
+            Vector mean;
+            Matrix inverse_covariance;
+            bool is_valid;
+        };
+
+        /** The cells covering the destination that contain a point, found
+         * through a hash table of their coordinates, with their points
+         * stored contiguously by cell. */
+        struct Grid {
+            Vector origin;
+            std::vector<Cell> cells;
+            std::vector<size_t> slots;
+            std::vector<size_t> cell_points;
+            std::vector<size_t> point_cells;
+        };
+
+        /** A pose as the rotation angle and the translation between the
+         * centered point clouds. */
+        struct Pose {
+            double theta;
+            Vector offset;
+        };
+
+        /** Marks an empty slot in Grid::slots, or a point in no cell. */
+        static constexpr size_t NO_CELL = SIZE_MAX;
+
+        double cell_size;
+        double radius;
+        std::array<Grid, 4> grids;
+        std::vector<Vector> grid_points;
+
+        NDT(double cell_size): ICP(), cell_size(cell_size) {
+            // A grid has at most one cell per destination point, so its
+            // buffers are bounded by the point count, not by its extent
+            reserve_points(grid_points);
+            for (Grid& grid: grids) {
+                reserve_points(grid.cells);
+                reserve_points(grid.cell_points);
+                reserve_points(grid.point_cells);
+                if (max_points != std::numeric_limits<size_t>::max()) {
+                    grid.slots.reserve(slot_count(max_points));
+                }
+            }
+        }
+        ~NDT() override {}
+
+        size_t method_memory_usage() const override {
+            size_t usage = grid_points.capacity() * sizeof(Vector);
+            for (const Grid& grid: grids) {
+                usage += grid.cells.capacity() * sizeof(Cell)
+                         + (grid.slots.capacity() + grid.cell_points.capacity()
+                               + grid.point_cells.capacity())
+                               * sizeof(size_t);
+            }
+            return usage;
+        }
+
+        /** The size of a hash table for `points` cells, a power of two at
+         * least twice as large so that probes stay short. */
+        static size_t slot_count(size_t points) {
+            size_t count = 1;
+            while (count < 2 * points) {
+                count *= 2;
+            }
+            return count;
+        }
+
+        /** The slot in `grid` holding the cell at (`x`, `y`), or the empty
+         * slot where it would be inserted. */
+        size_t probe(const Grid& grid, long x, long y) const {
+            const size_t mask = grid.slots.size() - 1;
+            size_t slot = ((size_t)x * 73856093 ^ (size_t)y * 19349663)
+                          & mask;
+            for (;;) {
+                const size_t c = grid.slots[slot];
+                if (c == NO_CELL
+                    || (grid.cells[c].x == x && grid.cells[c].y == y)) {
+                    return slot;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        /** The index of the cell at (`x`, `y`) in `grid`, or NDT::NO_CELL if
+         * it contains no destination point. */
+        size_t find(const Grid& grid, long x, long y) const {
+            return grid.slots[probe(grid, x, y)];
+        }
+
+        long column_of(const Grid& grid, const Vector& point) const {
+            return (long)std::floor((point.x() - grid.origin.x()) / cell_size);
+        }
+
+        long row_of(const Grid& grid, const Vector& point) const {
+            return (long)std::floor((point.y() - grid.origin.y()) / cell_size);
+        }
+
+        size_t cell_of(const Grid& grid, const Vector& point) const {
+            return find(grid, column_of(grid, point), row_of(grid, point));
+        }
+
+        void build_grid(Grid& grid, const Vector& origin) {
+            grid.origin = origin;
+            grid.cells.clear();
+            grid.slots.assign(slot_count(b.size()), NO_CELL);
+
+            // Bucket the points by cell (counting sort)
+            grid.point_cells.resize(b.size());
+            for (size_t j = 0; j < b.size(); j++) {
+                const long x = column_of(grid, b[j]);
+                const long y = row_of(grid, b[j]);
+                size_t& c = grid.slots[probe(grid, x, y)];
+                if (c == NO_CELL) {
+                    c = grid.cells.size();
+                    grid.cells.emplace_back();
+                    grid.cells[c].x = x;
+                    grid.cells[c].y = y;
+                    grid.cells[c].count = 0;
+                }
+                grid.cells[c].count++;
+                grid.point_cells[j] = c;
+            }
+            size_t offset = 0;
+            for (Cell& cell: grid.cells) {
+                cell.start = offset;
+                offset += cell.count;
+                cell.count = 0;
+            }
+            grid.cell_points.resize(b.size());
+            for (size_t j = 0; j < b.size(); j++) {
+                Cell& cell = grid.cells[grid.point_cells[j]];
+                grid.cell_points[cell.start + cell.count++] = j;
+            }
+
+            for (Cell& cell: grid.cells) {
+                const size_t start = cell.start;
+                const size_t count = cell.count;
+                cell.is_valid = count >= 3;
+                if (!cell.is_valid) {
+                    continue;
+                }
+
+                cell.mean = Vector::Zero();
+                for (size_t k = start; k < start + count; k++) {
+                    cell.mean += b[grid.cell_points[k]];
+                }
+                cell.mean /= count;
+
+                Matrix covariance = Matrix::Zero();
+                for (size_t k = start; k < start + count; k++) {
+                    const Vector q = b[grid.cell_points[k]] - cell.mean;
+                    covariance += q * q.transpose();
+                }
+                covariance /= count - 1;
+
+                // Points along a wall give a nearly singular covariance, so
+                // the smaller eigenvalue is bounded below. The closed form
+                // for a 2x2 matrix avoids the iterative solver, whose
+                // Householder temporaries warn under -Wmaybe-uninitialized
+                Eigen::SelfAdjointEigenSolver<Matrix> solver;
+                solver.computeDirect(covariance);
+                Vector eigenvalues = solver.eigenvalues();
+                const double floor = std::max(1e-3 * eigenvalues(1),
+                    1e-6 * cell_size * cell_size);
+                eigenvalues = eigenvalues.cwiseMax(floor);
+                cell.inverse_covariance = solver.eigenvectors()
+                                          * eigenvalues.cwiseInverse()
+                                                .asDiagonal()
+                                          * solver.eigenvectors().transpose();
+            }
+        }
+
+        void setup() override {
+            // The rotation is optimized as an arc length at this radius so
+            // that all three parameters share the units of the point clouds
+            radius = 0;
+            for (const Vector& point: a) {
+                radius += point.squaredNorm();
+            }
+            radius = a.empty() ? 1 : std::max(std::sqrt(radius / a.size()),
+                                         1e-9);
+
+            if (grid_points == b) {
+                return;
+            }
+            grid_points = b;
+
+            /*
+                #step
+                Grid Construction: summarize the destination.
+
+                The destination is divided into square cells of side
+                `"cell_size"`, and the points in each cell with at least three
+                points are summarized by their mean and covariance. Four such
+                grids, shifted by half a cell in each direction, are overlaid
+                to smooth the discontinuities at cell boundaries. Only the
+                cells containing points are stored, in a hash table of their
+                coordinates, so a grid takes memory in proportion to the
+                destination rather than to its extent. The grids are only
+                rebuilt when the destination changes.
+
+                Sources:
+                https://doi.org/10.1109/IROS.2003.1249285
+            */
+            Vector min = Vector::Constant(INFINITY);
+            for (const Vector& point: b) {
+                min = min.cwiseMin(point);
+            }
+            if (b.empty()) {
+                min = Vector::Zero();
+            }
+            for (size_t k = 0; k < grids.size(); k++) {
+                const Vector shift((k & 1) * cell_size / 2,
+                    (k >> 1) * cell_size / 2);
+                build_grid(grids[k], min - shift);
+            }
+        }
+
+        Pose current_pose() const {
+            const double theta = std::atan2(transform.rotation(1, 0),
+                transform.rotation(0, 0));
+            return Pose{theta,
+                transform.rotation * a_cm + transform.translation - b_cm};
+        }
+
+        static Matrix rotation_of(double theta) {
+            return Matrix{{std::cos(theta), -std::sin(theta)},
+                {std::sin(theta), std::cos(theta)}};
+        }
+
+        /** The negative likelihood of the source under `pose`, computing
+         * its gradient and Hessian if requested. `hits` counts the source
+         * points that landed in a valid cell. */
+        double score(const Pose& pose, Eigen::Vector3d* gradient,
+            Eigen::Matrix3d* hessian, size_t* hits = nullptr) {
+            const Matrix rotation = rotation_of(pose.theta);
+            const Matrix rotation_d = Matrix{{0, -1}, {1, 0}} * rotation;
+            double total = 0;
+            if (gradient) {
+                gradient->setZero();
+                hessian->setZero();
+            }
+            for (const Vector& source: a) {
+                const Vector point = rotation * source + pose.offset;
+                for (const Grid& grid: grids) {
+                    const size_t c = cell_of(grid, point);
+                    if (c == NO_CELL || !grid.cells[c].is_valid) {
+                        continue;
+                    }
+                    if (hits) {
+                        (*hits)++;
+                    }
+                    const Cell& cell = grid.cells[c];
+                    const Vector q = point - cell.mean;
+                    distance_evaluations++;
+                    const Vector Sq = cell.inverse_covariance * q;
+                    const double e = std::exp(-0.5 * q.dot(Sq));
+                    total -= e;
+                    if (!gradient) {
+                        continue;
+                    }
+
+                    // Jacobian of the point in (offset x, offset y, arc)
+                    const Vector arm = rotation_d * source / radius;
+                    Eigen::Matrix<double, 2, 3> J;
+                    J << 1, 0, arm.x(), 0, 1, arm.y();
+                    const Eigen::Vector3d qSJ = J.transpose() * Sq;
+                    *gradient += e * qSJ;
+                    *hessian += e
+                                * (J.transpose() * cell.inverse_covariance * J
+                                    - qSJ * qSJ.transpose());
+                    (*hessian)(2, 2) -= e * Sq.dot(rotation * source)
+                                        / (radius * radius);
+                }
+            }
+            return total;
+        }
+
+        /** Fills `matches` with the closest destination point among the
+         * cells around each rotated source point. */
+        void match_nearby(const Pose& pose) {
+            const Grid& grid = grids[0];
+            const Matrix rotation = rotation_of(pose.theta);
+            matches.resize(a.size());
+            matched_count = a.size();
+            inlier_sums = InlierSums();
+            for (size_t i = 0; i < a.size(); i++) {
+                const Vector placed = rotation * a[i] + pose.offset;
+                double closest = INFINITY;
+                size_t pair = 0;
+                const long x = column_of(grid, placed);
+                const long y = row_of(grid, placed);
+                for (long cy = y - 1; cy <= y + 1; cy++) {
+                    for (long cx = x - 1; cx <= x + 1; cx++) {
+                        const size_t c = find(grid, cx, cy);
+                        if (c == NO_CELL) {
+                            continue;
+                        }
+                        const Cell& cell = grid.cells[c];
+                        distance_evaluations += cell.count;
+                        for (size_t k = cell.start;
+                             k < cell.start + cell.count; k++) {
+                            const size_t j = grid.cell_points[k];
+                            const double dist = (b[j] - placed).squaredNorm();
+                            if (dist < closest) {
+                                closest = dist;
+                                pair = j;
+                            }
+                        }
+                    }
+                }
+
+                // Far from every cell, fall back to searching everything
+                if (closest == INFINITY) {
+                    distance_evaluations += b.size();
+                    for (size_t j = 0; j < b.size(); j++) {
+                        const double dist = (b[j] - placed).squaredNorm();
+                        if (dist < closest) {
+                            closest = dist;
+                            pair = j;
+                        }
+                    }
+                }
+                matches[i].pair = pair;
+                matches[i].sq_dist = closest;
+
+                // Every point contributes to the likelihood
+                add_inlier(i);
+            }
+        }
+
+        bool matches_by_point() const override {
+            return false;
+        }
+
+        void iterate() override {
+            Pose pose = current_pose();
+            Timeline::Span phase("match");
+
+            /*
+                #step
+                Matching Step: record correspondences for the cost.
+
+                NDT does not need correspondences, but to report a cost
+                comparable to the other methods, each source point is matched
+                to the closest destination point in the 3x3 block of cells
+                around it.
+            */
+            match_nearby(pose);
+            phase.next("newton");
+
+            /*
+                #step
+                Newton Step: optimize the likelihood.
+
+                The score is the negative sum, over all grids, of the
+                unnormalized likelihood of each transformed source point
+                under the distribution of the cell it lands in. One Newton
+                step is taken on the translation and the rotation (as an arc
+                length at the RMS radius of the source), with the Hessian
+                shifted to be positive definite, the step limited to half a
+                cell, and then halved until the score decreases.
+
+                Sources:
+                https://doi.org/10.1109/IROS.2003.1249285
+                https://www.diva-portal.org/smash/get/diva2:276162/FULLTEXT02.pdf
+            */
+            Eigen::Vector3d gradient = Eigen::Vector3d::Zero();
+            Eigen::Matrix3d hessian = Eigen::Matrix3d::Zero();
+            size_t hits = 0;
+            const double current = score(pose, &gradient, &hessian, &hits);
+
+            /*
+                #step
+                Fallback Step: align the centroids.
+
+                If no source point lands in a cell with enough points to
+                summarize, such as for very sparse destinations, the
+                likelihood carries no information, so the centroids are
+                aligned instead as in \ref vanilla_icp.
+            */
+            if (hits == 0) {
+                transform.translation = b_cm - transform.rotation * a_cm;
+                return;
+            }
+
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(hessian);
+            const double min_eigenvalue = solver.eigenvalues()(0);
+            const double max_eigenvalue = std::abs(solver.eigenvalues()(2));
+            if (min_eigenvalue < 1e-2 * max_eigenvalue) {
+                hessian += (1e-2 * max_eigenvalue - min_eigenvalue)
+                           * Eigen::Matrix3d::Identity();
+            }
+            Eigen::Vector3d step = -hessian.ldlt().solve(gradient);
+
+            // The cell distributions say nothing beyond about a cell away
+            if (step.norm() > cell_size / 2) {
+                step *= cell_size / 2 / step.norm();
+            }
+            for (double scale = 1; scale > 1e-3; scale /= 2) {
+                Pose next{pose.theta + scale * step(2) / radius,
+                    pose.offset + scale * step.head<2>()};
+                if (score(next, nullptr, nullptr) < current) {
+                    pose = next;
+                    break;
+                }
+            }
+
+            transform.rotation = rotation_of(pose.theta);
+            transform.translation = pose.offset + b_cm
+                                    - transform.rotation * a_cm;
+        }
+    };
+
+    static bool static_initialization = []() {
+        assert(ICP::register_method("ndt",
+            [](const ICP::Config& config) -> std::unique_ptr<ICP> {
+                /* #conf "cell_size" A positive `double` for the side length
+                 * of a grid cell, in the units of the point clouds. Alignment
+                 * errors larger than about a cell cannot be corrected. The
+                 * default is `100.0`. */
+                double cell_size = config.get<double>("cell_size", 100.0);
+                assert(cell_size > 0);
+                return std::make_unique<NDT>(cell_size);
+            }));
+        return true;
+    }();
+}
@@ -5,7 +5,9 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <numeric>
 #include "../icp.h"
+#include "../timeline.h"
 #include <Eigen/Core>
 #include <Eigen/SVD>
 
@@ -17,9 +19,16 @@ namespace icp {
         double overlap_rate;
         std::vector<icp::Vector> a_rot;
 
-        Test1(double overlap_rate): ICP(), overlap_rate(overlap_rate) {}
+        Test1(double overlap_rate): ICP(), overlap_rate(overlap_rate) {
+            reserve_points(a_rot);
+            reserve_points(ranked_matches);
+        }
         ~Test1() override {}
 
+        size_t method_memory_usage() const override {
+            return a_rot.capacity() * sizeof(Vector);
+        }
+
         void setup() override {
             if (a_rot.size() < a.size()) {
                 a_rot.resize(a.size());
@@ -28,7 +37,6 @@ namespace icp {
 
         void iterate() override {
             size_t n = a.size();
-            const size_t m = b.size();
 
             for (size_t i = 0; i < n; i++) {
                 a_rot[i] = transform.rotation * a[i];
@@ -36,28 +44,23 @@ namespace icp {
 
             /* #step Matching Step: see \ref vanilla_icp
             for details. */
-            for (size_t i = 0; i < n; i++) {
-                matches[i].point = i;
-                matches[i].sq_dist = std::numeric_limits<double>::infinity();
-                for (size_t j = 0; j < m; j++) {
-                    // Point-to-point matching
-                    double dist_ij = (b[j] - a_rot[i]).squaredNorm();
-
-                    if (dist_ij < matches[i].sq_dist) {
-                        matches[i].sq_dist = dist_ij;
-                        matches[i].pair = j;
-                    }
-                }
-            }
+            compute_matches(a_rot);
+            Timeline::Span phase("trim");
 
             /*
                 #step Trimming Step: see \ref trimmed_icp for details.
             */
-            std::sort(matches.begin(), matches.end(),
-                [](const auto& a, const auto& b) {
-                    return a.sq_dist < b.sq_dist;
+            ranked_matches.resize(n);
+            std::iota(ranked_matches.begin(), ranked_matches.end(), 0);
+            const size_t matched = matched_count;
+            std::sort(ranked_matches.begin(), ranked_matches.begin() + matched,
+                [this](MatchIndex i, MatchIndex j) {
+                    return matches[i].sq_dist < matches[j].sq_dist;
                 });
-            n = (size_t)(overlap_rate * n);
+            n = (size_t)(overlap_rate * matched);
+            inlier_count = n;
+
+            phase.next("solve");
 
             /*
                 #step
@@ -69,20 +72,22 @@ namespace icp {
              */
 
             transform.translation = Vector::Zero();
-            for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < n; k++) {
+                const size_t i = ranked_matches[k];
                 transform.translation += (b[matches[i].pair] + b_cm)
-                                         - transform.rotation
-                                               * (a[matches[i].point] + a_cm);
+                                         - transform.rotation * (a[i] + a_cm);
             }
             transform.translation /= n;
 
             // no clue why this might still work
             // TODO: mathematically see if you can justify it, otherwise scrap
             // and find new method
-            Matrix N{};
-            for (size_t i = 0; i < n; i++) {
-                N += (a[matches[i].point] + transform.translation)
+            Matrix N = Matrix::Zero();
+            for (size_t k = 0; k < n; k++) {
+                const size_t i = ranked_matches[k];
+                N += (a[i] + transform.translation)
                      * b[matches[i].pair].transpose();
+                add_inlier(i);
             }
             auto svd = N.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV);
             const Matrix U = svd.matrixU();
@@ -5,7 +5,10 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <numeric>
 #include "../icp.h"
+#include "../timeline.h"
+#include "../../algo/quickselect.h"
 #include <Eigen/Core>
 #include <Eigen/SVD>
 
@@ -14,25 +17,88 @@
 /* #desc Trimmed ICP is identical to \ref vanilla_icp with the addition of an
 overlap rate parameter, which specifies the percentage of points between the two
 point sets that have correspondences. When the overlap rate is 1, the algorithm
-reduces to vanilla. */
+reduces to vanilla. The overlap rate can also be estimated automatically each
+iteration, as in fractional ICP. */
 
 namespace icp {
     struct Trimmed final : public ICP {
         double overlap_rate;
+        bool adaptive_overlap;
+        double min_overlap_rate;
+        double overlap_step;
+        double overlap_lambda;
         std::vector<icp::Vector> a_rot;
-
-        Trimmed(double overlap_rate): ICP(), overlap_rate(overlap_rate) {}
+        std::vector<size_t> overlap_ranks;
+
+        Trimmed(double overlap_rate, bool adaptive_overlap,
+            double min_overlap_rate, double overlap_step,
+            double overlap_lambda)
+            : ICP(),
+              overlap_rate(overlap_rate),
+              adaptive_overlap(adaptive_overlap),
+              min_overlap_rate(min_overlap_rate),
+              overlap_step(overlap_step),
+              overlap_lambda(overlap_lambda) {
+            reserve_points(a_rot);
+            reserve_points(ranked_matches);
+            overlap_ranks.reserve(
+                (size_t)std::ceil((1 - min_overlap_rate) / overlap_step) + 2);
+        }
         ~Trimmed() override {}
 
+        size_t method_memory_usage() const override {
+            return a_rot.capacity() * sizeof(Vector)
+                   + overlap_ranks.capacity() * sizeof(size_t);
+        }
+
         void setup() override {
             if (a_rot.size() < a.size()) {
                 a_rot.resize(a.size());
             }
+
+            // Candidate overlaps, as the rank of the last match they keep
+            const size_t n = a.size();
+            overlap_ranks.clear();
+            for (double f = min_overlap_rate; f < 1 + overlap_step / 2;
+                 f += overlap_step) {
+                size_t k = std::clamp((size_t)std::ceil(std::min(f, 1.0) * n),
+                    (size_t)1, n);
+                if (overlap_ranks.empty() || overlap_ranks.back() < k - 1) {
+                    overlap_ranks.push_back(k - 1);
+                }
+            }
+        }
+
+        size_t estimate_overlap() {
+            const size_t n = a.size();
+            multiselect(ranked_matches.begin(), ranked_matches.end(),
+                overlap_ranks.begin(), overlap_ranks.end(),
+                [this](MatchIndex i, MatchIndex j) {
+                    return matches[i].sq_dist < matches[j].sq_dist;
+                });
+
+            size_t best_count = n;
+            double best_error = std::numeric_limits<double>::infinity();
+            double prefix_sum = 0;
+            size_t i = 0;
+            for (size_t rank: overlap_ranks) {
+                for (; i <= rank; i++) {
+                    prefix_sum += matches[ranked_matches[i]].sq_dist;
+                }
+                const size_t count = rank + 1;
+                const double f = (double)count / n;
+                const double error = std::sqrt(prefix_sum / count)
+                                     / std::pow(f, overlap_lambda);
+                if (error < best_error) {
+                    best_error = error;
+                    best_count = count;
+                }
+            }
+            return best_count;
         }
 
         void iterate() override {
             size_t n = a.size();
-            const size_t m = b.size();
 
             for (size_t i = 0; i < n; i++) {
                 a_rot[i] = transform.rotation * a[i];
@@ -40,34 +106,52 @@ namespace icp {
 
             /* #step Matching Step: see \ref vanilla_icp
             for details. */
-            for (size_t i = 0; i < n; i++) {
-                matches[i].point = i;
-                matches[i].sq_dist = std::numeric_limits<double>::infinity();
-                for (size_t j = 0; j < m; j++) {
-                    // Point-to-point matching
-                    double dist_ij = (b[j] - a_rot[i]).squaredNorm();
-
-                    if (dist_ij < matches[i].sq_dist) {
-                        matches[i].sq_dist = dist_ij;
-                        matches[i].pair = j;
-                    }
-                }
-            }
+            compute_matches(a_rot);
+            Timeline::Span phase("trim");
 
             /*
                 #step
                 Trimming Step
 
-                Matches are considered in increasing order of distance.
+                Matches are considered in increasing order of distance, by
+                ranking their indices rather than moving the matches.
 
                 Sources:
                 https://ieeexplore.ieee.org/abstract/document/1047997
             */
-            std::sort(matches.begin(), matches.end(),
-                [](const auto& a, const auto& b) {
-                    return a.sq_dist < b.sq_dist;
-                });
-            n = (size_t)(overlap_rate * n);
+            ranked_matches.resize(n);
+            std::iota(ranked_matches.begin(), ranked_matches.end(), 0);
+
+            // A budget may have left a suffix unmatched, which stays last
+            const size_t matched = matched_count;
+            if (adaptive_overlap && matched == n && n > 0) {
+                /*
+                    #step
+                    Overlap Estimation Step (if `"adaptive_overlap"` is set)
+
+                    Instead of a fixed overlap rate, the fraction `f` of
+                    matches kept is chosen among the candidate fractions to
+                    minimize the fractional RMSD `sqrt(S(f) / (f n)) / f^λ`,
+                    where `S(f)` is the sum of the `f n` smallest squared
+                    distances. The matches are only partially ordered at the
+                    candidate boundaries, so every `S(f)` is a prefix sum over
+                    one selection pass rather than a full sort.
+
+                    Sources:
+                    https://doi.org/10.1109/3DIM.2007.11
+                */
+                n = estimate_overlap();
+            } else {
+                std::sort(ranked_matches.begin(),
+                    ranked_matches.begin() + matched,
+                    [this](MatchIndex i, MatchIndex j) {
+                        return matches[i].sq_dist < matches[j].sq_dist;
+                    });
+                n = (size_t)(overlap_rate * matched);
+            }
+            inlier_count = n;
+
+            phase.next("solve");
 
             /*
                 #step
@@ -75,9 +159,11 @@ namespace icp {
              */
             transform.translation = b_cm - transform.rotation * a_cm;
 
-            Matrix N{};
-            for (size_t i = 0; i < n; i++) {
-                N += a[matches[i].point] * b[matches[i].pair].transpose();
+            Matrix N = Matrix::Zero();
+            for (size_t k = 0; k < n; k++) {
+                const size_t i = ranked_matches[k];
+                N += a[i] * b[matches[i].pair].transpose();
+                add_inlier(i);
             }
             auto svd = N.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV);
             const Matrix U = svd.matrixU();
@@ -93,7 +179,35 @@ namespace icp {
                  * the overlap rate. The default is `1.0`. */
                 double overlap_rate = config.get<double>("overlap_rate", 1.0);
                 assert(overlap_rate >= 0 && overlap_rate <= 1);
-                return std::make_unique<Trimmed>(overlap_rate);
+
+                /* #conf "adaptive_overlap" An `int` which, when nonzero,
+                 * ignores `"overlap_rate"` and instead estimates the overlap
+                 * rate every iteration. The default is `0`. */
+                bool adaptive_overlap = config.get<int>("adaptive_overlap", 0);
+
+                /* #conf "min_overlap_rate" A `double` between `0.0` and `1.0`
+                 * for the smallest overlap rate considered when estimating
+                 * it. The default is `0.4`. */
+                double min_overlap_rate = config.get<double>(
+                    "min_overlap_rate", 0.4);
+                assert(min_overlap_rate > 0 && min_overlap_rate <= 1);
+
+                /* #conf "overlap_step" A positive `double` for the spacing
+                 * between candidate overlap rates when estimating it. The
+                 * default is `0.05`. */
+                double overlap_step = config.get<double>("overlap_step", 0.05);
+                assert(overlap_step > 0);
+
+                /* #conf "overlap_lambda" A positive `double` for how strongly
+                 * smaller overlap rates are penalized when estimating it. The
+                 * default is `3.0`. */
+                double overlap_lambda = config.get<double>("overlap_lambda",
+                    3.0);
+                assert(overlap_lambda > 0);
+
+                return std::make_unique<Trimmed>(overlap_rate,
+                    adaptive_overlap, min_overlap_rate, overlap_step,
+                    overlap_lambda);
             }));
         return true;
     }();
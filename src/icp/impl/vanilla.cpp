@@ -6,6 +6,7 @@
 #include <cassert>
 #include <cstdlib>
 #include "../icp.h"
+#include "../timeline.h"
 #include <Eigen/Core>
 #include <Eigen/SVD>
 
@@ -18,9 +19,15 @@ namespace icp {
     struct Vanilla final : public ICP {
         std::vector<icp::Vector> a_rot;
 
-        Vanilla(): ICP() {}
+        Vanilla(): ICP() {
+            reserve_points(a_rot);
+        }
         ~Vanilla() override {}
 
+        size_t method_memory_usage() const override {
+            return a_rot.capacity() * sizeof(Vector);
+        }
+
         void setup() override {
             if (a_rot.size() < a.size()) {
                 a_rot.resize(a.size());
@@ -29,7 +36,6 @@ namespace icp {
 
         void iterate() override {
             const size_t n = a.size();
-            const size_t m = b.size();
 
             for (size_t i = 0; i < n; i++) {
                 a_rot[i] = transform.rotation * a[i];
@@ -46,18 +52,8 @@ namespace icp {
                 https://courses.cs.duke.edu/spring07/cps296.2/scribe_notes/lecture24.pdf
                 -> use k-d tree
              */
-            for (size_t i = 0; i < n; i++) {
-                matches[i].sq_dist = std::numeric_limits<double>::infinity();
-                for (size_t j = 0; j < m; j++) {
-                    // Point-to-point matching
-                    double dist_ij = (b[j] - a_rot[i]).squaredNorm();
-
-                    if (dist_ij < matches[i].sq_dist) {
-                        matches[i].sq_dist = dist_ij;
-                        matches[i].pair = j;
-                    }
-                }
-            }
+            compute_matches(a_rot);
+            Timeline::Span phase("solve");
 
             /*
                 #step
@@ -72,9 +68,10 @@ namespace icp {
              */
             transform.translation = b_cm - transform.rotation * a_cm;
 
-            Matrix N{};
+            Matrix N = Matrix::Zero();
             for (size_t i = 0; i < n; i++) {
                 N += a[i] * b[matches[i].pair].transpose();
+                add_inlier(i);
             }
             auto svd = N.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV);
             const Matrix U = svd.matrixU();
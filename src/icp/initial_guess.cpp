@@ -0,0 +1,155 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "initial_guess.h"
+
+namespace icp {
+    InitialGuess::InitialGuess(InitialGuessParams params): params(params) {}
+
+    void InitialGuess::build_histogram(const std::vector<Vector>& points,
+        std::vector<double>& histogram) {
+        const size_t bins = params.bins;
+        correlation.assign(bins, 0);
+        histogram.assign(bins, 0);
+        if (points.size() < 2) {
+            return;
+        }
+
+        // Segments much longer than usual span a gap rather than a surface
+        const size_t span = std::min(params.span, points.size() - 1);
+        lengths.clear();
+        for (size_t i = 0; i + span < points.size(); i++) {
+            lengths.push_back((points[i + span] - points[i]).norm());
+        }
+        std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2,
+            lengths.end());
+        const double max_length = params.gap_ratio
+                                  * lengths[lengths.size() / 2];
+
+        // Orientations are lines, so they repeat every half turn
+        for (size_t i = 0; i + span < points.size(); i++) {
+            const Vector segment = points[i + span] - points[i];
+            const double length = segment.norm();
+            if (length == 0 || length > max_length) {
+                continue;
+            }
+            double angle = std::atan2(segment.y(), segment.x());
+            if (angle < 0) {
+                angle += M_PI;
+            }
+
+            // Split between the two nearest bins to avoid quantization
+            const double position = angle / M_PI * bins;
+            const double lower = std::floor(position);
+            const double fraction = position - lower;
+            correlation[(size_t)lower % bins] += (1 - fraction) * length;
+            correlation[((size_t)lower + 1) % bins] += fraction * length;
+        }
+
+        // Blur so that nearby orientations still correlate
+        constexpr double kernel[5] = {1, 4, 6, 4, 1};
+        for (size_t k = 0; k < bins; k++) {
+            for (size_t j = 0; j < 5; j++) {
+                histogram[(k + j + bins - 2) % bins] += kernel[j]
+                                                        * correlation[k];
+            }
+        }
+    }
+
+    double InitialGuess::score(const std::vector<Vector>& a,
+        const std::vector<Vector>& b, const RBTransform& transform) const {
+        const size_t samples = std::min(params.sample_size, a.size());
+        double sum = 0;
+        for (size_t s = 0; s < samples; s++) {
+            const Vector point = transform.apply_to(a[s * a.size() / samples]);
+            double closest = std::numeric_limits<double>::infinity();
+            for (const Vector& other: b) {
+                closest = std::min(closest, (other - point).squaredNorm());
+            }
+            sum += closest;
+        }
+        return sum;
+    }
+
+    RBTransform InitialGuess::estimate(const std::vector<Vector>& a,
+        const std::vector<Vector>& b) {
+        const Vector a_cm = get_centroid(a);
+        const Vector b_cm = get_centroid(b);
+        if (a.empty() || b.empty()) {
+            return RBTransform();
+        }
+
+        // The destination histogram is the source's shifted by the rotation
+        const size_t bins = params.bins;
+        build_histogram(a, source_histogram);
+        build_histogram(b, destination_histogram);
+        correlation.assign(bins, 0);
+        for (size_t shift = 0; shift < bins; shift++) {
+            for (size_t k = 0; k < bins; k++) {
+                correlation[shift] += source_histogram[k]
+                                      * destination_histogram[(k + shift)
+                                                              % bins];
+            }
+        }
+
+        // Candidates must improve by more than rounding error to win, so
+        // that ties go to the smaller rotation
+        double scale = 0;
+        for (const Vector& point: a) {
+            scale = std::max(scale, (point - a_cm).squaredNorm());
+        }
+        const double tolerance = 1e-9 * scale * params.sample_size;
+
+        RBTransform best;
+        best.translation = b_cm - a_cm;
+        double best_score = score(a, b, best);
+        std::vector<bool> is_taken(bins, false);
+        for (size_t peak = 0; peak < params.peaks; peak++) {
+            // The highest local maximum not yet tried
+            size_t shift = bins;
+            for (size_t s = 0; s < bins; s++) {
+                const double value = correlation[s];
+                if (!is_taken[s] && value > 0
+                    && value > correlation[(s + bins - 1) % bins]
+                    && value >= correlation[(s + 1) % bins]
+                    && (shift == bins || value > correlation[shift])) {
+                    shift = s;
+                }
+            }
+            if (shift == bins) {
+                break;
+            }
+            is_taken[shift] = true;
+
+            // Interpolate between bins with a parabola through the peak,
+            // whose vertex lies toward the larger neighbour
+            const double left = correlation[(shift + bins - 1) % bins];
+            const double center = correlation[shift];
+            const double right = correlation[(shift + 1) % bins];
+            const double curvature = left - 2 * center + right;
+            const double offset = curvature < 0
+                                      ? (left - right) / (2 * curvature)
+                                      : 0;
+            const double angle = (shift + offset) * M_PI / bins;
+
+            for (double candidate: {angle, angle + M_PI}) {
+                RBTransform transform;
+                transform.rotation << std::cos(candidate),
+                    -std::sin(candidate), std::sin(candidate),
+                    std::cos(candidate);
+                transform.translation = b_cm - transform.rotation * a_cm;
+                const double candidate_score = score(a, b, transform);
+                if (candidate_score + tolerance < best_score) {
+                    best_score = candidate_score;
+                    best = transform;
+                }
+            }
+        }
+        return best;
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include "geo.h"
+
+namespace icp {
+    /** Tuning for an InitialGuess. */
+    struct InitialGuessParams {
+        /** The number of orientation bins covering half a turn. */
+        size_t bins = 180;
+
+        /** How many points apart the ends of each local surface segment
+         * are. */
+        size_t span = 4;
+
+        /** Segments longer than this many times the median segment length
+         * cross a gap in the scan and are ignored. */
+        double gap_ratio = 8;
+
+        /** How many correlation peaks are considered. */
+        size_t peaks = 2;
+
+        /** How many source points each candidate is scored on. */
+        size_t sample_size = 32;
+    };
+
+    /**
+     * Estimates a transform between two scans, without any correspondences,
+     * to pass as the initial guess to ICP::begin, so that ICP converges even
+     * when the scans are rotated far apart.
+     *
+     * The local surface orientations of each scan are collected into a
+     * histogram weighted by length, which a rotation shifts circularly. The
+     * circular cross-correlation of the two histograms then peaks at the
+     * rotation modulo half a turn. Each of the highest peaks, and its
+     * opposite, is scored by how close a small sample of source points lands
+     * to the destination when the centroids are aligned, and the best is
+     * returned.
+     *
+     * \par Example
+     * @code
+     * icp::InitialGuess guess;
+     * icp->begin(a, b, guess.estimate(a, b));
+     * @endcode
+     *
+     * \par Efficiency:
+     * `O(a.size() + b.size() + bins^2 + peaks * sample_size * b.size())`,
+     * which is far less than one brute-force iteration.
+     */
+    class InitialGuess {
+        InitialGuessParams params;
+        std::vector<double> source_histogram;
+        std::vector<double> destination_histogram;
+        std::vector<double> correlation;
+        std::vector<double> lengths;
+
+        void build_histogram(const std::vector<Vector>& points,
+            std::vector<double>& histogram);
+        double score(const std::vector<Vector>& a,
+            const std::vector<Vector>& b, const RBTransform& transform) const;
+
+    public:
+        InitialGuess(InitialGuessParams params = InitialGuessParams());
+
+        /**
+         * Estimates the transform taking `a` onto `b`. Both point clouds
+         * must be in angular order around the sensor, as from a
+         * PolarConverter, since surface orientations are taken between
+         * points nearby in that order.
+         */
+        RBTransform estimate(const std::vector<Vector>& a,
+            const std::vector<Vector>& b);
+    };
+}
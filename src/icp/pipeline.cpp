@@ -0,0 +1,294 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include "pipeline.h"
+#include "timeline.h"
+
+// How many times a waiting stage rechecks its queue before sleeping
+#define SPIN_LIMIT 64
+
+namespace icp {
+    template<typename T>
+    ScanPipeline::Queue<T>::Queue(size_t capacity)
+        : ring(capacity),
+          max_depth(0),
+          pushed(0),
+          dropped(0),
+          producer_sleeping(false),
+          consumer_sleeping(false) {}
+
+    template<typename T>
+    T* ScanPipeline::Queue<T>::acquire_blocking() {
+        T* slot;
+        sleep(producer_sleeping,
+            [&]() { return (slot = ring.acquire()) != nullptr; });
+        return slot;
+    }
+
+    template<typename T>
+    void ScanPipeline::Queue<T>::commit() {
+        ring.commit();
+        pushed.fetch_add(1, std::memory_order_relaxed);
+
+        // Only the producer writes these, so there is no race between the
+        // load and the store
+        const size_t depth = ring.size();
+        if (depth > max_depth.load(std::memory_order_relaxed)) {
+            max_depth.store(depth, std::memory_order_relaxed);
+        }
+        notify();
+    }
+
+    template<typename T>
+    void ScanPipeline::Queue<T>::release() {
+        ring.release();
+        wake(producer_sleeping);
+    }
+
+    template<typename T>
+    template<typename F>
+    void ScanPipeline::Queue<T>::wait(F is_ready) {
+        sleep(consumer_sleeping, is_ready);
+    }
+
+    template<typename T>
+    void ScanPipeline::Queue<T>::notify() {
+        wake(consumer_sleeping);
+    }
+
+    template<typename T>
+    template<typename F>
+    void ScanPipeline::Queue<T>::sleep(std::atomic<bool>& sleeping,
+        F is_ready) {
+        for (size_t i = 0; i < SPIN_LIMIT; i++) {
+            if (is_ready()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        // The flag is raised before the check under the lock, and the fence
+        // pairs with the one in Queue::wake: either this check sees the
+        // change or the other side sees the flag and takes the lock
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        changed.wait(lock, is_ready);
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+
+    template<typename T>
+    void ScanPipeline::Queue<T>::wake(std::atomic<bool>& sleeping) {
+        // Nobody is asleep on the common path, so the hand-off costs a fence
+        // rather than a lock
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!sleeping.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // Taking the lock orders this after any check in progress in sleep
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        changed.notify_all();
+    }
+
+    template<typename T>
+    QueueStats ScanPipeline::Queue<T>::stats() const {
+        return QueueStats{ring.capacity(), ring.size(),
+            max_depth.load(std::memory_order_relaxed),
+            pushed.load(std::memory_order_relaxed),
+            dropped.load(std::memory_order_relaxed)};
+    }
+
+    ScanPipeline::ScanPipeline(std::unique_ptr<ICP> icp, Output output,
+        Preprocess preprocess, PipelineOptions options)
+        : icp(std::move(icp)),
+          output(std::move(output)),
+          preprocess(std::move(preprocess)),
+          options(options),
+          converter(options.scale),
+          converted(options.queue_capacity),
+          preprocessed(options.queue_capacity),
+          aligned(options.queue_capacity),
+          closed(false),
+          preprocess_done(false),
+          align_done(false) {
+        for (size_t i = 0; i < converted.ring.capacity(); i++) {
+            converted.ring.slot(i).points.reserve(options.max_points);
+            preprocessed.ring.slot(i).points.reserve(options.max_points);
+        }
+        preprocess_thread = std::thread(&ScanPipeline::run_preprocess, this);
+        align_thread = std::thread(&ScanPipeline::run_align, this);
+        output_thread = std::thread(&ScanPipeline::run_output, this);
+    }
+
+    ScanPipeline::~ScanPipeline() {
+        finish();
+    }
+
+    template<typename T>
+    bool ScanPipeline::convert(const T* ranges, size_t count,
+        const ScanGeometry& geometry, double timestamp) {
+        if (closed.load(std::memory_order_acquire)) {
+            converted.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Scan* slot = converted.ring.acquire();
+        if (!slot) {
+            if (options.drop_policy == DropPolicy::drop_newest) {
+                converted.dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            slot = converted.acquire_blocking();
+        }
+
+        // Convert straight into the slot, so the scan is never copied
+        Timeline::Span span("convert");
+        slot->timestamp = timestamp;
+        converter.convert(ranges, count, geometry, slot->points);
+        converted.commit();
+        return true;
+    }
+
+    bool ScanPipeline::push(const float* ranges, size_t count,
+        const ScanGeometry& geometry, double timestamp) {
+        return convert(ranges, count, geometry, timestamp);
+    }
+
+    bool ScanPipeline::push(const double* ranges, size_t count,
+        const ScanGeometry& geometry, double timestamp) {
+        return convert(ranges, count, geometry, timestamp);
+    }
+
+    void ScanPipeline::run_preprocess() {
+        for (;;) {
+            // Checked before the queue so that no scan committed before the
+            // flag was set is missed
+            const bool upstream_done = closed.load(std::memory_order_acquire);
+            Scan* input = converted.ring.front();
+            if (!input) {
+                if (upstream_done) {
+                    break;
+                }
+                converted.wait([this]() {
+                    return closed.load(std::memory_order_acquire)
+                           || converted.ring.front();
+                });
+                continue;
+            }
+
+            // Swapping hands the input's storage to the output slot and the
+            // output slot's spare storage back to the input queue
+            Scan* slot = preprocessed.acquire_blocking();
+            slot->timestamp = input->timestamp;
+            slot->points.swap(input->points);
+            converted.release();
+
+            if (preprocess) {
+                Timeline::Span span("preprocess");
+                preprocess(slot->points);
+            }
+            preprocessed.commit();
+        }
+        preprocess_done.store(true, std::memory_order_release);
+        preprocessed.notify();
+    }
+
+    void ScanPipeline::run_align() {
+        std::vector<Vector> previous;
+        previous.reserve(options.max_points);
+        bool has_previous = false;
+        RBTransform relative;
+        RBTransform pose;
+
+        for (;;) {
+            const bool upstream_done = preprocess_done.load(
+                std::memory_order_acquire);
+            Scan* input = preprocessed.ring.front();
+            if (!input) {
+                if (upstream_done) {
+                    break;
+                }
+                preprocessed.wait([this]() {
+                    return preprocess_done.load(std::memory_order_acquire)
+                           || preprocessed.ring.front();
+                });
+                continue;
+            }
+
+            PipelineResult* slot = aligned.acquire_blocking();
+            slot->timestamp = input->timestamp;
+            slot->report = ICP::ConvergenceReport{};
+            if (has_previous) {
+                Timeline::Span span("align");
+
+                // The motion between scans changes slowly, so the last
+                // relative transform is a good initial guess, and stands in
+                // for scans too large to align
+                if (icp->begin(input->points, previous, relative)) {
+                    slot->report = icp->converge(options.burn_in,
+                        options.convergence_threshold);
+                    relative = icp->current_transform();
+                }
+                pose = RBTransform(pose.rotation * relative.translation
+                                       + pose.translation,
+                    pose.rotation * relative.rotation);
+            }
+            slot->relative = relative;
+            slot->pose = pose;
+            has_previous = true;
+
+            previous.swap(input->points);
+            preprocessed.release();
+            aligned.commit();
+        }
+        align_done.store(true, std::memory_order_release);
+        aligned.notify();
+    }
+
+    void ScanPipeline::run_output() {
+        for (;;) {
+            const bool upstream_done = align_done.load(
+                std::memory_order_acquire);
+            PipelineResult* input = aligned.ring.front();
+            if (!input) {
+                if (upstream_done) {
+                    break;
+                }
+                aligned.wait([this]() {
+                    return align_done.load(std::memory_order_acquire)
+                           || aligned.ring.front();
+                });
+                continue;
+            }
+            if (output) {
+                Timeline::Span span("output");
+                output(*input);
+            }
+            aligned.release();
+        }
+    }
+
+    void ScanPipeline::finish() {
+        closed.store(true, std::memory_order_release);
+        converted.notify();
+        if (preprocess_thread.joinable()) {
+            preprocess_thread.join();
+        }
+        if (align_thread.joinable()) {
+            align_thread.join();
+        }
+        if (output_thread.joinable()) {
+            output_thread.join();
+        }
+    }
+
+    PipelineStats ScanPipeline::stats() const {
+        return PipelineStats{converted.stats(), preprocessed.stats(),
+            aligned.stats()};
+    }
+}
@@ -0,0 +1,243 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+#include "icp.h"
+#include "polar.h"
+#include "../algo/spsc_ring.h"
+
+namespace icp {
+    /** What ScanPipeline::push does when the pipeline is full. */
+    enum class DropPolicy {
+        /** Wait for the pipeline to make room, so no scan is lost. */
+        block,
+
+        /** Discard the incoming scan, so the caller never waits. */
+        drop_newest
+    };
+
+    /** Configuration for a ScanPipeline. */
+    struct PipelineOptions {
+        /** The number of scans each queue between stages can hold. Rounded up
+         * to a power of two. */
+        size_t queue_capacity = 4;
+
+        /** The number of points storage is reserved for in every queue slot.
+         * Larger scans still work but allocate. */
+        size_t max_points = 2048;
+
+        /** What happens to scans pushed while the first queue is full. The
+         * later stages always wait for room. */
+        DropPolicy drop_policy = DropPolicy::drop_newest;
+
+        /** Passed to ICP::converge. */
+        size_t burn_in = 0;
+
+        /** Passed to ICP::converge. */
+        double convergence_threshold = 20;
+
+        /** Passed to the PolarConverter, e.g., `100` for centimeters. */
+        double scale = 1;
+    };
+
+    /** The alignment of one scan produced by a ScanPipeline. */
+    struct PipelineResult {
+        /** The timestamp given to ScanPipeline::push. */
+        double timestamp;
+
+        /** The transform from this scan to the previous one. The identity
+         * for the first scan. */
+        RBTransform relative;
+
+        /** The transform from this scan to the first one. */
+        RBTransform pose;
+
+        /** How the alignment against the previous scan converged. */
+        ICP::ConvergenceReport report;
+    };
+
+    /** Statistics about one queue between pipeline stages. */
+    struct QueueStats {
+        size_t capacity;
+
+        /** The number of scans waiting in the queue now. */
+        size_t depth;
+
+        /** The most scans that have waited in the queue at once. */
+        size_t max_depth;
+
+        /** The number of scans that entered the queue. */
+        size_t pushed;
+
+        /** The number of scans discarded because the queue was full. */
+        size_t dropped;
+    };
+
+    /** Statistics about every queue of a ScanPipeline. */
+    struct PipelineStats {
+        /** Between conversion and preprocessing. */
+        QueueStats converted;
+
+        /** Between preprocessing and alignment. */
+        QueueStats preprocessed;
+
+        /** Between alignment and output. */
+        QueueStats aligned;
+    };
+
+    /**
+     * Runs scan-to-scan odometry as four concurrent stages, so that a new
+     * scan is converted and preprocessed while the previous one is still
+     * being aligned:
+     *
+     * 1. Conversion of raw ranges into points, on the thread calling
+     * ScanPipeline::push.
+     * 2. Preprocessing of the points by a user-supplied function.
+     * 3. Alignment of each scan to the previous one with an ICP instance.
+     * 4. Output of the result to a user-supplied function.
+     *
+     * Consecutive stages are joined by lock-free single-producer,
+     * single-consumer ring buffers whose slots are allocated once, so once
+     * running, no stage allocates for scans within
+     * PipelineOptions::max_points. A stage waiting on an empty or full
+     * queue spins briefly and then sleeps until the other side wakes it, so
+     * an idle pipeline uses no CPU.
+     *
+     * \par Example
+     * @code
+     * icp::ScanPipeline pipeline(icp::ICP::from_method("vanilla"),
+     *     [](const icp::PipelineResult& result) { publish(result.pose); });
+     *
+     * // In the sensor callback
+     * pipeline.push(msg.ranges.data(), msg.ranges.size(), geometry,
+     *     msg.header.stamp.toSec());
+     *
+     * // On shutdown
+     * pipeline.finish();
+     * @endcode
+     */
+    class ScanPipeline {
+    public:
+        /** Transforms the points of a scan in place before alignment. */
+        using Preprocess = std::function<void(std::vector<Vector>&)>;
+
+        /** Receives each aligned scan, in order. */
+        using Output = std::function<void(const PipelineResult&)>;
+
+        /** Starts a pipeline aligning scans with `icp` and passing the
+         * results to `output`. If `preprocess` is not empty, it is applied
+         * to every scan before alignment. */
+        ScanPipeline(std::unique_ptr<ICP> icp, Output output,
+            Preprocess preprocess = nullptr,
+            PipelineOptions options = PipelineOptions());
+
+        /** Calls ScanPipeline::finish. */
+        ~ScanPipeline();
+
+        ScanPipeline(const ScanPipeline&) = delete;
+        ScanPipeline& operator=(const ScanPipeline&) = delete;
+
+        /**
+         * Converts the `count` beams in `ranges` described by `geometry` and
+         * enqueues them for alignment. Must only be called from one thread
+         * at a time.
+         *
+         * @returns `false` if the scan was dropped, either by
+         * DropPolicy::drop_newest or because the pipeline has finished.
+         */
+        bool push(const float* ranges, size_t count,
+            const ScanGeometry& geometry, double timestamp);
+
+        /** @see ScanPipeline::push */
+        bool push(const double* ranges, size_t count,
+            const ScanGeometry& geometry, double timestamp);
+
+        /** Waits for every pushed scan to be output and stops the stages.
+         * Later pushes are dropped. */
+        void finish();
+
+        /** The current statistics of every queue. */
+        PipelineStats stats() const;
+
+    private:
+        struct Scan {
+            double timestamp;
+            std::vector<Vector> points;
+        };
+
+        /** A queue, the counters updated by its producer, and the
+         * condition either side sleeps on while waiting for the other. */
+        template<typename T>
+        struct Queue {
+            SPSCRing<T> ring;
+            std::atomic<size_t> max_depth;
+            std::atomic<size_t> pushed;
+            std::atomic<size_t> dropped;
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::atomic<bool> producer_sleeping;
+            std::atomic<bool> consumer_sleeping;
+
+            Queue(size_t capacity);
+
+            /** Waits for a free slot. */
+            T* acquire_blocking();
+            void commit();
+            void release();
+
+            /** Waits as the consumer until `is_ready()` returns `true`, which
+             * must become so only before a call to Queue::commit or
+             * Queue::notify. */
+            template<typename F>
+            void wait(F is_ready);
+
+            /** Wakes the consumer if it is sleeping in Queue::wait. */
+            void notify();
+
+            /** Sleeps until `is_ready()` returns `true`, raising `sleeping`
+             * so that Queue::wake knows to take the lock. */
+            template<typename F>
+            void sleep(std::atomic<bool>& sleeping, F is_ready);
+
+            /** Wakes the side waiting on `sleeping`, if it is asleep. */
+            void wake(std::atomic<bool>& sleeping);
+
+            QueueStats stats() const;
+        };
+
+        template<typename T>
+        bool convert(const T* ranges, size_t count,
+            const ScanGeometry& geometry, double timestamp);
+
+        void run_preprocess();
+        void run_align();
+        void run_output();
+
+        std::unique_ptr<ICP> icp;
+        Output output;
+        Preprocess preprocess;
+        PipelineOptions options;
+        PolarConverter converter;
+
+        Queue<Scan> converted;
+        Queue<Scan> preprocessed;
+        Queue<PipelineResult> aligned;
+
+        std::atomic<bool> closed;
+        std::atomic<bool> preprocess_done;
+        std::atomic<bool> align_done;
+
+        std::thread preprocess_thread;
+        std::thread align_thread;
+        std::thread output_thread;
+    };
+}
@@ -0,0 +1,63 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <cmath>
+#include "polar.h"
+
+namespace icp {
+    PolarConverter::PolarConverter(double scale)
+        : scale(scale), angle_min(NAN), angle_increment(NAN) {}
+
+    void PolarConverter::prepare(size_t count, const ScanGeometry& geometry) {
+        if (cos_table.size() == count && angle_min == geometry.angle_min
+            && angle_increment == geometry.angle_increment) {
+            return;
+        }
+
+        angle_min = geometry.angle_min;
+        angle_increment = geometry.angle_increment;
+        cos_table.resize(count);
+        sin_table.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const double angle = angle_min + i * angle_increment;
+            cos_table[i] = scale * std::cos(angle);
+            sin_table[i] = scale * std::sin(angle);
+        }
+    }
+
+    template<typename T>
+    size_t PolarConverter::convert_ranges(const T* ranges, size_t count,
+        const ScanGeometry& geometry, std::vector<Vector>& points) {
+        prepare(count, geometry);
+        points.resize(count);
+
+        // Every beam is written unconditionally and the output position only
+        // advances past valid ones, so the loop has no data-dependent branch
+        const double range_min = geometry.range_min;
+        const double range_max = geometry.range_max;
+        const double* cos_data = cos_table.data();
+        const double* sin_data = sin_table.data();
+        Vector* out = points.data();
+        size_t valid = 0;
+        for (size_t i = 0; i < count; i++) {
+            const double range = ranges[i];
+            out[valid] = Vector(range * cos_data[i], range * sin_data[i]);
+            valid += (range >= range_min) & (range <= range_max);
+        }
+
+        points.resize(valid);
+        return valid;
+    }
+
+    size_t PolarConverter::convert(const float* ranges, size_t count,
+        const ScanGeometry& geometry, std::vector<Vector>& points) {
+        return convert_ranges(ranges, count, geometry, points);
+    }
+
+    size_t PolarConverter::convert(const double* ranges, size_t count,
+        const ScanGeometry& geometry, std::vector<Vector>& points) {
+        return convert_ranges(ranges, count, geometry, points);
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include "geo.h"
+
+namespace icp {
+    /** The fields of
+     * [`sensor_msgs::LaserScan`](http://docs.ros.org/en/api/sensor_msgs/html/msg/LaserScan.html)
+     * that determine where each range lies. */
+    struct ScanGeometry {
+        double angle_min;
+        double angle_increment;
+        double range_min;
+        double range_max;
+    };
+
+    /**
+     * Converts raw LiDAR ranges into a point cloud. The sine and cosine of
+     * every beam angle are cached, so repeated scans from the same sensor
+     * cost no trigonometry.
+     *
+     * \par Example
+     * @code
+     * // Once per sensor: output points in centimeters
+     * icp::PolarConverter converter(100);
+     * std::vector<icp::Vector> points;
+     *
+     * // For every scan
+     * converter.convert(msg.ranges.data(), msg.ranges.size(),
+     *     {msg.angle_min, msg.angle_increment, msg.range_min,
+     *         msg.range_max},
+     *     points);
+     * @endcode
+     */
+    class PolarConverter {
+        double scale;
+        double angle_min;
+        double angle_increment;
+        std::vector<double> cos_table;
+        std::vector<double> sin_table;
+
+        void prepare(size_t count, const ScanGeometry& geometry);
+
+        template<typename T>
+        size_t convert_ranges(const T* ranges, size_t count,
+            const ScanGeometry& geometry, std::vector<Vector>& points);
+
+    public:
+        /** Constructs a converter whose points are the ranges multiplied by
+         * `scale`, e.g., `100` to go from meters to centimeters. */
+        PolarConverter(double scale = 1);
+
+        /**
+         * Converts the `count` beams in `ranges` to points, dropping ranges
+         * that lie outside `[geometry.range_min, geometry.range_max]` or are
+         * not a number. `points` is resized to the number of valid ranges,
+         * which is returned; its storage is reused across calls.
+         *
+         * \par Efficiency:
+         * `O(count)` without trigonometry when `count` and the angles of
+         * `geometry` match the previous call.
+         */
+        size_t convert(const float* ranges, size_t count,
+            const ScanGeometry& geometry, std::vector<Vector>& points);
+
+        /** @see PolarConverter::convert */
+        size_t convert(const double* ranges, size_t count,
+            const ScanGeometry& geometry, std::vector<Vector>& points);
+    };
+}
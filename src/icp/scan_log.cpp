@@ -0,0 +1,213 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scan_log.h"
+
+#define LOG_MAGIC "ICPL"
+#define LOG_VERSION 1
+#define LOG_HEADER_SIZE 24
+#define LOG_MAX_QUANTIZED 65534
+
+namespace icp {
+    static_assert(sizeof(ScanView::Header) == 40,
+        "scan records must have the same layout on every platform");
+
+    ScanView::ScanView(const Header* header, const uint16_t* quantized)
+        : header(header), data(quantized) {}
+
+    double ScanView::timestamp() const {
+        return header->timestamp;
+    }
+
+    ScanGeometry ScanView::geometry() const {
+        return ScanGeometry{header->angle_min, header->angle_increment,
+            header->range_min, header->range_max};
+    }
+
+    size_t ScanView::size() const {
+        return header->count;
+    }
+
+    const uint16_t* ScanView::quantized() const {
+        return data;
+    }
+
+    double ScanView::range(size_t i) const {
+        return data[i] ? data[i] * (double)header->range_unit : INFINITY;
+    }
+
+    void ScanView::ranges(std::vector<float>& ranges) const {
+        ranges.resize(header->count);
+        const float unit = header->range_unit;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            ranges[i] = data[i] ? data[i] * unit : INFINITY;
+        }
+    }
+
+    ScanLog::ScanLog(): data(nullptr), length(0), index(nullptr), count(0) {}
+
+    ScanLog::~ScanLog() {
+        close();
+    }
+
+    bool ScanLog::open(const std::string& path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < LOG_HEADER_SIZE) {
+            ::close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+            fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(mapping);
+        length = info.st_size;
+
+        uint32_t header[3];
+        uint64_t index_offset;
+        memcpy(header, data + 4, sizeof(header));
+        memcpy(&index_offset, data + 16, sizeof(index_offset));
+        count = header[1];
+        bool ok = memcmp(data, LOG_MAGIC, 4) == 0 && header[0] == LOG_VERSION
+                  && index_offset % 8 == 0 && index_offset <= length
+                  && (length - index_offset) / sizeof(uint64_t) >= count;
+
+        // Check every record once so that views never read out of bounds
+        if (ok) {
+            index = reinterpret_cast<const uint64_t*>(data + index_offset);
+            for (size_t i = 0; ok && i < count; i++) {
+                const uint64_t offset = index[i];
+                ok = offset % 8 == 0 && offset <= index_offset
+                     && index_offset - offset >= sizeof(ScanView::Header)
+                     && (index_offset - offset - sizeof(ScanView::Header))
+                                / sizeof(uint16_t)
+                            >= scan(i).size();
+            }
+        }
+        if (!ok) {
+            close();
+        }
+        return ok;
+    }
+
+    void ScanLog::close() {
+        if (data) {
+            munmap(const_cast<uint8_t*>(data), length);
+        }
+        data = nullptr;
+        length = 0;
+        index = nullptr;
+        count = 0;
+    }
+
+    size_t ScanLog::size() const {
+        return count;
+    }
+
+    ScanView ScanLog::scan(size_t i) const {
+        const uint8_t* record = data + index[i];
+        return ScanView(reinterpret_cast<const ScanView::Header*>(record),
+            reinterpret_cast<const uint16_t*>(
+                record + sizeof(ScanView::Header)));
+    }
+
+    ScanLogWriter::ScanLogWriter(): file(nullptr), ok(false) {}
+
+    ScanLogWriter::~ScanLogWriter() {
+        close();
+    }
+
+    bool ScanLogWriter::open(const std::string& path) {
+        close();
+        file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        offsets.clear();
+
+        // The scan count and index offset are filled in on close
+        const uint8_t header[LOG_HEADER_SIZE] = {};
+        ok = fwrite(header, sizeof(header), 1, file) == 1;
+        return ok;
+    }
+
+    template<typename T>
+    bool ScanLogWriter::add_ranges(double timestamp,
+        const ScanGeometry& geometry, const T* ranges, size_t count) {
+        if (!file || !ok) {
+            return false;
+        }
+
+        const double unit = geometry.range_max / LOG_MAX_QUANTIZED;
+        quantized.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const double range = ranges[i];
+            if (!(range >= geometry.range_min && range <= geometry.range_max)) {
+                quantized[i] = 0;
+                continue;
+            }
+            const long step = std::lround(range / unit);
+            quantized[i] = (uint16_t)std::clamp(step, 1L,
+                (long)LOG_MAX_QUANTIZED);
+        }
+
+        const ScanView::Header header{timestamp, geometry.angle_min,
+            geometry.angle_increment, (float)geometry.range_min,
+            (float)geometry.range_max, (float)unit, (uint32_t)count};
+        offsets.push_back(ftell(file));
+        const uint8_t padding[8] = {};
+        const size_t padding_size = (8 - count * sizeof(uint16_t) % 8) % 8;
+        ok = fwrite(&header, sizeof(header), 1, file) == 1
+             && fwrite(quantized.data(), sizeof(uint16_t), count, file)
+                    == count
+             && fwrite(padding, 1, padding_size, file) == padding_size;
+        return ok;
+    }
+
+    bool ScanLogWriter::add(double timestamp, const ScanGeometry& geometry,
+        const float* ranges, size_t count) {
+        return add_ranges(timestamp, geometry, ranges, count);
+    }
+
+    bool ScanLogWriter::add(double timestamp, const ScanGeometry& geometry,
+        const double* ranges, size_t count) {
+        return add_ranges(timestamp, geometry, ranges, count);
+    }
+
+    bool ScanLogWriter::close() {
+        if (!file) {
+            return false;
+        }
+
+        const uint64_t index_offset = ftell(file);
+        const uint32_t header[3] = {LOG_VERSION, (uint32_t)offsets.size(), 0};
+        ok = ok
+             && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file)
+                    == offsets.size()
+             && fseek(file, 0, SEEK_SET) == 0
+             && fwrite(LOG_MAGIC, 4, 1, file) == 1
+             && fwrite(header, sizeof(header), 1, file) == 1
+             && fwrite(&index_offset, sizeof(index_offset), 1, file) == 1;
+
+        ok = fclose(file) == 0 && ok;
+        file = nullptr;
+        return ok;
+    }
+}
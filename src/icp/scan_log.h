@@ -0,0 +1,161 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include "polar.h"
+
+namespace icp {
+    /**
+     * A view of one scan in a ScanLog, pointing directly into the mapped
+     * file. It is valid only while the ScanLog is open.
+     */
+    class ScanView {
+    public:
+        /** The fixed-size part of every scan record. */
+        struct Header {
+            double timestamp;
+            double angle_min;
+            double angle_increment;
+            float range_min;
+            float range_max;
+
+            /** The range represented by one quantization step. */
+            float range_unit;
+            uint32_t count;
+        };
+
+        ScanView(const Header* header, const uint16_t* quantized);
+
+        /** The timestamp the scan was logged with. */
+        double timestamp() const;
+
+        /** The angles and range limits of the beams. */
+        ScanGeometry geometry() const;
+
+        /** The number of beams. */
+        size_t size() const;
+
+        /** The quantized range of each beam, where zero means no return. */
+        const uint16_t* quantized() const;
+
+        /** The range of beam `i`, or infinity for no return. */
+        double range(size_t i) const;
+
+        /** Dequantizes every range into `ranges`, e.g., for
+         * PolarConverter::convert. */
+        void ranges(std::vector<float>& ranges) const;
+
+    private:
+        const Header* header;
+        const uint16_t* data;
+    };
+
+    /**
+     * A read-only, memory-mapped log of many LiDAR scans, with an index for
+     * random access. Scans are read in place without copying or parsing.
+     *
+     * \par Example
+     * @code
+     * icp::ScanLog log;
+     * if (!log.open("drive.icplog")) { ... }
+     * icp::PolarConverter converter(100);
+     * std::vector<float> ranges;
+     * std::vector<icp::Vector> points;
+     * for (size_t i = 0; i < log.size(); i++) {
+     *     icp::ScanView scan = log.scan(i);
+     *     scan.ranges(ranges);
+     *     converter.convert(ranges.data(), ranges.size(), scan.geometry(),
+     *         points);
+     * }
+     * @endcode
+     *
+     * \par File Format
+     * All values are stored in host byte order, and every record starts at
+     * a multiple of 8 bytes.
+     * 1. The magic bytes `ICPL`, then the `uint32_t` version, scan count, and
+     * flags (currently zero), and the `uint64_t` offset of the index.
+     * 2. For each scan, a ScanView::Header followed by its `count` ranges as
+     * `uint16_t` multiples of `range_unit`, where zero means no return.
+     * 3. The index: the `uint64_t` offset of each scan record.
+     */
+    class ScanLog {
+    public:
+        ScanLog();
+        ~ScanLog();
+
+        ScanLog(const ScanLog&) = delete;
+        ScanLog& operator=(const ScanLog&) = delete;
+
+        /** Maps the log at `path`, returning `false` if it could not be read
+         * or is not a valid log. Closes any log already open. */
+        bool open(const std::string& path);
+
+        /** Unmaps the log, invalidating every view. */
+        void close();
+
+        /** The number of scans. */
+        size_t size() const;
+
+        /** The `i`th scan.
+         *
+         * @pre `i < size()`. */
+        ScanView scan(size_t i) const;
+
+    private:
+        const uint8_t* data;
+        size_t length;
+        const uint64_t* index;
+        size_t count;
+    };
+
+    /** Writes scans to a file readable by ScanLog. */
+    class ScanLogWriter {
+    public:
+        ScanLogWriter();
+
+        /** Calls ScanLogWriter::close. */
+        ~ScanLogWriter();
+
+        ScanLogWriter(const ScanLogWriter&) = delete;
+        ScanLogWriter& operator=(const ScanLogWriter&) = delete;
+
+        /** Starts a new log at `path`, returning `false` on failure. */
+        bool open(const std::string& path);
+
+        /**
+         * Appends a scan of `count` beams. Ranges outside
+         * `[geometry.range_min, geometry.range_max]` or not a number are
+         * stored as no return, and the rest are quantized to within
+         * `geometry.range_max / 131068`.
+         *
+         * @returns `false` on failure.
+         */
+        bool add(double timestamp, const ScanGeometry& geometry,
+            const float* ranges, size_t count);
+
+        /** @see ScanLogWriter::add */
+        bool add(double timestamp, const ScanGeometry& geometry,
+            const double* ranges, size_t count);
+
+        /** Writes the index and closes the file, returning `false` on
+         * failure. */
+        bool close();
+
+    private:
+        FILE* file;
+        bool ok;
+        std::vector<uint64_t> offsets;
+        std::vector<uint16_t> quantized;
+
+        template<typename T>
+        bool add_ranges(double timestamp, const ScanGeometry& geometry,
+            const T* ranges, size_t count);
+    };
+}
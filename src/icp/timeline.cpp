@@ -0,0 +1,109 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "timeline.h"
+
+namespace icp {
+    struct TimelineEvent {
+        const char* name;
+        int64_t start;
+        int64_t end;
+    };
+
+    /** The spans recorded by one thread. */
+    struct TimelineThread {
+        uint32_t id;
+        std::vector<TimelineEvent> events;
+    };
+
+    static std::atomic<bool> timeline_enabled(false);
+    static std::chrono::steady_clock::time_point timeline_epoch;
+
+    // Buffers outlive their threads so that spans from finished threads are
+    // still saved
+    static std::mutex timeline_mutex;
+    static std::vector<std::unique_ptr<TimelineThread>> timeline_threads;
+    static thread_local TimelineThread* timeline_thread = nullptr;
+
+    Timeline::Span::Span(const char* name)
+        : name(name), start(is_enabled() ? Timeline::now() : -1) {}
+
+    Timeline::Span::~Span() {
+        if (start >= 0) {
+            Timeline::add(name, start, Timeline::now());
+        }
+    }
+
+    void Timeline::Span::next(const char* name) {
+        if (start >= 0) {
+            const int64_t end = Timeline::now();
+            Timeline::add(this->name, start, end);
+            start = end;
+        }
+        this->name = name;
+    }
+
+    void Timeline::enable() {
+        if (!is_enabled()) {
+            timeline_epoch = std::chrono::steady_clock::now();
+            timeline_enabled.store(true, std::memory_order_release);
+        }
+    }
+
+    bool Timeline::is_enabled() {
+        return timeline_enabled.load(std::memory_order_acquire);
+    }
+
+    int64_t Timeline::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - timeline_epoch)
+            .count();
+    }
+
+    void Timeline::add(const char* name, int64_t start, int64_t end) {
+        if (!timeline_thread) {
+            std::lock_guard<std::mutex> lock(timeline_mutex);
+            timeline_threads.push_back(std::make_unique<TimelineThread>());
+            timeline_thread = timeline_threads.back().get();
+            timeline_thread->id = timeline_threads.size();
+            timeline_thread->events.reserve(4096);
+        }
+        timeline_thread->events.push_back(TimelineEvent{name, start, end});
+    }
+
+    bool Timeline::save(const std::string& path) {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(timeline_mutex);
+        bool ok = fputs("{\"traceEvents\":[", file) >= 0;
+        bool is_first = true;
+        for (const std::unique_ptr<TimelineThread>& thread: timeline_threads) {
+            for (const TimelineEvent& event: thread->events) {
+                // Complete events, with times in microseconds
+                ok = ok
+                     && fprintf(file,
+                            "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                            "\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                            is_first ? "" : ",", event.name, thread->id,
+                            event.start / 1e3,
+                            (event.end - event.start) / 1e3)
+                            > 0;
+                is_first = false;
+            }
+        }
+        ok = ok && fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file) >= 0;
+
+        return fclose(file) == 0 && ok;
+    }
+}
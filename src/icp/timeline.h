@@ -0,0 +1,69 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace icp {
+    /**
+     * A process-wide recorder of timed spans, such as the phases of each ICP
+     * iteration, which can be written out as Chrome trace-event JSON and
+     * opened in `chrome://tracing` or [Perfetto](https://ui.perfetto.dev).
+     *
+     * Recording is off until Timeline::enable is called, and a disabled span
+     * costs one atomic load. Enabled spans are buffered in memory per thread,
+     * without locking, until Timeline::save.
+     *
+     * \par Example
+     * @code
+     * icp::Timeline::enable();
+     * {
+     *     icp::Timeline::Span span("load");
+     *     load_scans();
+     * }
+     * icp->converge(burn_in, convergence_threshold);
+     * icp::Timeline::save("run.json");
+     * @endcode
+     */
+    class Timeline {
+    public:
+        /** Records the time from its construction to its destruction. */
+        class Span {
+            const char* name;
+            int64_t start;
+
+        public:
+            /** Starts a span named `name`, which must be a string literal or
+             * otherwise outlive the timeline. */
+            Span(const char* name);
+
+            /** Ends the span. */
+            ~Span();
+
+            /** Ends the span and starts the next phase, named `name`. */
+            void next(const char* name);
+
+            Span(const Span&) = delete;
+            Span& operator=(const Span&) = delete;
+        };
+
+        /** Starts recording spans. */
+        static void enable();
+
+        /** Whether spans are being recorded. */
+        static bool is_enabled();
+
+        /** Writes every recorded span to `path` as Chrome trace-event JSON,
+         * returning `false` on failure. No thread may be recording while
+         * the timeline is saved. */
+        static bool save(const std::string& path);
+
+    private:
+        static int64_t now();
+        static void add(const char* name, int64_t start, int64_t end);
+    };
+}
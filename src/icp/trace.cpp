@@ -0,0 +1,183 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "trace.h"
+
+#define TRACE_MAGIC "ICPT"
+#define TRACE_VERSION 2
+#define TRACE_FLAG_MATCHES 1u
+
+namespace icp {
+    IterationTrace::IterationTrace(bool record_matches)
+        : record_matches(record_matches) {}
+
+    void IterationTrace::begin(const std::vector<Vector>& source,
+        const std::vector<Vector>& destination) {
+        source_points = source;
+        destination_points = destination;
+        frames.clear();
+        frame_pairs.clear();
+    }
+
+    uint32_t* IterationTrace::add_frame(const RBTransform& transform,
+        const RBTransform& start, double cost) {
+        frames.push_back(Frame{transform, start, cost});
+        if (!record_matches) {
+            return nullptr;
+        }
+        const size_t n = source_points.size();
+        frame_pairs.resize(frame_pairs.size() + n, no_pair);
+        return frame_pairs.data() + frame_pairs.size() - n;
+    }
+
+    bool IterationTrace::has_matches() const {
+        return record_matches;
+    }
+
+    const std::vector<Vector>& IterationTrace::source() const {
+        return source_points;
+    }
+
+    const std::vector<Vector>& IterationTrace::destination() const {
+        return destination_points;
+    }
+
+    size_t IterationTrace::frame_count() const {
+        return frames.size();
+    }
+
+    const IterationTrace::Frame& IterationTrace::frame(size_t i) const {
+        return frames[i];
+    }
+
+    const uint32_t* IterationTrace::pairs(size_t i) const {
+        if (!record_matches) {
+            return nullptr;
+        }
+        return frame_pairs.data() + i * source_points.size();
+    }
+
+    static bool write_points(FILE* file, const std::vector<Vector>& points) {
+        for (const Vector& point: points) {
+            float xy[2] = {(float)point.x(), (float)point.y()};
+            if (fwrite(xy, sizeof(xy), 1, file) != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static double angle_of(const RBTransform& transform) {
+        return std::atan2(transform.rotation(1, 0), transform.rotation(0, 0));
+    }
+
+    static RBTransform transform_of(const double values[3]) {
+        Matrix rotation{{std::cos(values[2]), -std::sin(values[2])},
+            {std::sin(values[2]), std::cos(values[2])}};
+        return RBTransform(Vector(values[0], values[1]), rotation);
+    }
+
+    static bool read_points(FILE* file, std::vector<Vector>& points,
+        size_t count) {
+        points.resize(count);
+        for (Vector& point: points) {
+            float xy[2];
+            if (fread(xy, sizeof(xy), 1, file) != 1) {
+                return false;
+            }
+            point = Vector(xy[0], xy[1]);
+        }
+        return true;
+    }
+
+    bool IterationTrace::save(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+
+        const size_t n = source_points.size();
+        uint32_t header[5] = {TRACE_VERSION,
+            record_matches ? TRACE_FLAG_MATCHES : 0, (uint32_t)n,
+            (uint32_t)destination_points.size(), (uint32_t)frames.size()};
+        bool ok = fwrite(TRACE_MAGIC, 4, 1, file) == 1
+                  && fwrite(header, sizeof(header), 1, file) == 1
+                  && write_points(file, source_points)
+                  && write_points(file, destination_points);
+
+        for (size_t i = 0; ok && i < frames.size(); i++) {
+            const Frame& frame = frames[i];
+            double values[7] = {frame.transform.translation.x(),
+                frame.transform.translation.y(), angle_of(frame.transform),
+                frame.start.translation.x(), frame.start.translation.y(),
+                angle_of(frame.start), frame.cost};
+            ok = fwrite(values, sizeof(values), 1, file) == 1;
+            if (ok && record_matches && n > 0) {
+                ok = fwrite(pairs(i), sizeof(uint32_t), n, file) == n;
+            }
+        }
+
+        return fclose(file) == 0 && ok;
+    }
+
+    bool IterationTrace::load(const std::string& path, IterationTrace& trace) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+
+        char magic[4];
+        uint32_t header[5] = {};
+        bool ok = fread(magic, sizeof(magic), 1, file) == 1
+                  && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0
+                  && fread(header, sizeof(header), 1, file) == 1
+                  && header[0] == TRACE_VERSION;
+
+        // The counts must account for exactly the rest of the file, so a
+        // corrupt header cannot ask for more memory than the file holds
+        const bool has_matches = header[1] & TRACE_FLAG_MATCHES;
+        const uint64_t n = header[2];
+        const uint64_t points_size = (n + header[3]) * 2 * sizeof(float);
+        const uint64_t frame_size = 7 * sizeof(double)
+                                    + (has_matches ? n * sizeof(uint32_t)
+                                                   : 0);
+        if (ok) {
+            const long start = ftell(file);
+            ok = start >= 0 && fseek(file, 0, SEEK_END) == 0;
+            const long end = ok ? ftell(file) : -1;
+            ok = ok && end >= start && fseek(file, start, SEEK_SET) == 0;
+            const uint64_t remaining = ok ? end - start : 0;
+            ok = ok && points_size <= remaining
+                 && (remaining - points_size) % frame_size == 0
+                 && (remaining - points_size) / frame_size == header[4];
+        }
+
+        if (ok) {
+            trace.record_matches = has_matches;
+            trace.frames.clear();
+            trace.frame_pairs.clear();
+            ok = read_points(file, trace.source_points, header[2])
+                 && read_points(file, trace.destination_points, header[3]);
+        }
+
+        for (uint32_t i = 0; ok && i < header[4]; i++) {
+            double values[7];
+            ok = fread(values, sizeof(values), 1, file) == 1;
+            if (!ok) {
+                break;
+            }
+            uint32_t* pairs = trace.add_frame(transform_of(values),
+                transform_of(values + 3), values[6]);
+            if (pairs && n > 0) {
+                ok = fread(pairs, sizeof(uint32_t), n, file) == n;
+            }
+        }
+
+        fclose(file);
+        return ok;
+    }
+}
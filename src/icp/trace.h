@@ -0,0 +1,107 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "geo.h"
+
+namespace icp {
+    /**
+     * A compact recording of the iterations performed by an ICP instance,
+     * which can be saved to and loaded from a binary file for offline
+     * inspection without recomputing anything.
+     *
+     * \par Example
+     * @code
+     * icp::IterationTrace trace(true);
+     * icp->record(&trace);
+     * icp->begin(a, b, icp::RBTransform());
+     * icp->converge(burn_in, convergence_threshold);
+     * trace.save("run.icptrace");
+     * @endcode
+     *
+     * \par File Format
+     * All values are stored in host byte order.
+     * 1. The magic bytes `ICPT`, then the `uint32_t` version, flags (bit 0 is
+     * set when correspondences are recorded), source point count,
+     * destination point count, and frame count.
+     * 2. The source and destination point clouds as `float` pairs.
+     * 3. For each frame, the translation and rotation angle of the
+     * transform, then of the start transform, then the cost, as `double`s,
+     * followed by one `uint32_t` pair index per source point if
+     * correspondences are recorded.
+     */
+    class IterationTrace {
+    public:
+        /** The index stored for a source point that was not matched. */
+        static constexpr uint32_t no_pair = UINT32_MAX;
+
+        /** A single recorded iteration. */
+        struct Frame {
+            /** The transform after the iteration. */
+            RBTransform transform;
+
+            /** The transform the iteration started from, which the cost and
+             * correspondences were measured at. */
+            RBTransform start;
+
+            /** The cost of `start`. */
+            double cost;
+        };
+
+        /** Constructs an empty trace, which records the correspondences of
+         * each iteration if `record_matches` is set. */
+        IterationTrace(bool record_matches = false);
+
+        /** Discards all recorded frames and stores the point clouds `source`
+         * and `destination` for a new run. */
+        void begin(const std::vector<Vector>& source,
+            const std::vector<Vector>& destination);
+
+        /** Appends a frame, returning storage for `source().size()` pair
+         * indices to be filled in by the caller, or `nullptr` if
+         * correspondences are not being recorded. */
+        uint32_t* add_frame(const RBTransform& transform,
+            const RBTransform& start, double cost);
+
+        /** Whether correspondences are recorded in this trace. */
+        bool has_matches() const;
+
+        /** The source point cloud. */
+        const std::vector<Vector>& source() const;
+
+        /** The destination point cloud. */
+        const std::vector<Vector>& destination() const;
+
+        /** The number of recorded frames. */
+        size_t frame_count() const;
+
+        /** The `i`th recorded frame. */
+        const Frame& frame(size_t i) const;
+
+        /** The pair index of each source point in the `i`th frame, or
+         * `nullptr` if correspondences are not recorded. */
+        const uint32_t* pairs(size_t i) const;
+
+        /** Writes the trace to `path`, returning `false` on failure. */
+        bool save(const std::string& path) const;
+
+        /** Reads a trace from `path` into `trace`, returning `false` if the
+         * file could not be read or is not a valid trace. The counts in the
+         * header are checked against the size of the file before anything
+         * is allocated. */
+        static bool load(const std::string& path, IterationTrace& trace);
+
+    private:
+        bool record_matches;
+        std::vector<Vector> source_points;
+        std::vector<Vector> destination_points;
+        std::vector<Frame> frames;
+        std::vector<uint32_t> frame_pairs;
+    };
+}
@@ -0,0 +1,154 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <limits>
+#include "lidar_sim.h"
+
+// How many boxes a room may place too close to its center before it gives up
+// on the rest
+#define ROOM_MAX_REJECTIONS 1000
+
+namespace sim {
+    void World::add_polygon(const std::vector<icp::Vector>& vertices,
+        bool closed) {
+        for (size_t i = 0; i + 1 < vertices.size(); i++) {
+            walls.push_back(Segment{vertices[i], vertices[i + 1]});
+        }
+        if (closed && vertices.size() > 2) {
+            walls.push_back(Segment{vertices.back(), vertices.front()});
+        }
+    }
+
+    const std::vector<Segment>& World::segments() const {
+        return walls;
+    }
+
+    World World::room(double width, double height, size_t obstacles,
+        unsigned seed) {
+        World world;
+        const double w = width / 2;
+        const double h = height / 2;
+        world.add_polygon({icp::Vector(-w, -h), icp::Vector(w, -h),
+            icp::Vector(w, h), icp::Vector(-w, h)});
+
+        // Box centers stay half a meter inside the walls, which leaves no
+        // room for any in a room a meter or less across
+        if (w <= 0.5 || h <= 0.5) {
+            return world;
+        }
+
+        // Boxes stay clear of the center so the sensor is never inside one
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> size(0.2, 0.8);
+        std::uniform_real_distribution<double> x(-w + 0.5, w - 0.5);
+        std::uniform_real_distribution<double> y(-h + 0.5, h - 0.5);
+        std::uniform_real_distribution<double> angle(0, M_PI);
+        size_t rejections = 0;
+        while (obstacles > 0 && rejections < ROOM_MAX_REJECTIONS) {
+            icp::Vector center(x(rng), y(rng));
+            const double half = size(rng) / 2;
+            if (center.norm() < 1 + half * M_SQRT2) {
+                rejections++;
+                continue;
+            }
+            const icp::RBTransform box = pose(center.x(), center.y(),
+                angle(rng));
+            world.add_polygon({box.apply_to(icp::Vector(-half, -half)),
+                box.apply_to(icp::Vector(half, -half)),
+                box.apply_to(icp::Vector(half, half)),
+                box.apply_to(icp::Vector(-half, half))});
+            obstacles--;
+        }
+        return world;
+    }
+
+    LidarSimulator::LidarSimulator(World world, LidarParams params,
+        unsigned seed)
+        : world(world), params(params), rng(seed) {}
+
+    double LidarSimulator::cast(const icp::Vector& origin,
+        const icp::Vector& direction) const {
+        double closest = std::numeric_limits<double>::infinity();
+        for (const Segment& wall: world.segments()) {
+            // Solve origin + t * direction = wall.start + s * edge
+            const icp::Vector edge = wall.end - wall.start;
+            const icp::Vector offset = wall.start - origin;
+            const double denominator = direction.x() * edge.y()
+                                       - direction.y() * edge.x();
+            if (denominator == 0) {
+                continue;
+            }
+            const double t = (offset.x() * edge.y() - offset.y() * edge.x())
+                             / denominator;
+            const double s = (offset.x() * direction.y()
+                                 - offset.y() * direction.x())
+                             / denominator;
+            if (t > 0 && s >= 0 && s <= 1 && t < closest) {
+                closest = t;
+            }
+        }
+        return closest;
+    }
+
+    SimulatedScan LidarSimulator::scan(const icp::RBTransform& pose) {
+        SimulatedScan result;
+        result.range_min = params.range_min;
+        result.range_max = params.range_max;
+        result.angle_min = params.angle_min;
+        result.angle_max = params.angle_max;
+        result.angle_increment = params.angle_increment;
+
+        std::normal_distribution<double> noise(0, params.noise_stddev);
+        std::bernoulli_distribution dropout(params.dropout_rate);
+
+        const size_t beams = (size_t)((params.angle_max - params.angle_min)
+                                      / params.angle_increment)
+                             + 1;
+        result.ranges.reserve(beams);
+        result.points.reserve(beams);
+        for (size_t i = 0; i < beams; i++) {
+            const double angle = params.angle_min + i * params.angle_increment;
+            const icp::Vector beam(std::cos(angle), std::sin(angle));
+
+            double range = cast(pose.translation, pose.rotation * beam);
+            if (params.noise_stddev > 0) {
+                range += noise(rng);
+            }
+            if (params.dropout_rate > 0 && dropout(rng)) {
+                range = std::numeric_limits<double>::infinity();
+            }
+            result.ranges.push_back(range);
+
+            if (range >= params.range_min && range <= params.range_max) {
+                result.points.push_back(100 * range * beam);
+            }
+        }
+
+        return result;
+    }
+
+    ScanPair LidarSimulator::scan_pair(const icp::RBTransform& source_pose,
+        const icp::RBTransform& destination_pose) {
+        ScanPair pair;
+        pair.source = scan(source_pose);
+        pair.destination = scan(destination_pose);
+
+        // A point p in the source frame is at source_pose(p) in the world,
+        // which is destination_pose^-1(source_pose(p)) in the destination
+        // frame
+        const icp::Matrix inverse = destination_pose.rotation.transpose();
+        pair.truth.rotation = inverse * source_pose.rotation;
+        pair.truth.translation = 100 * inverse
+                                 * (source_pose.translation
+                                     - destination_pose.translation);
+        return pair;
+    }
+
+    icp::RBTransform pose(double x, double y, double theta) {
+        return icp::RBTransform(icp::Vector(x, y),
+            icp::Matrix{{std::cos(theta), -std::sin(theta)},
+                {std::sin(theta), std::cos(theta)}});
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include "icp/geo.h"
+
+namespace sim {
+    /** A wall between two points. Units: meters. */
+    struct Segment {
+        icp::Vector start;
+        icp::Vector end;
+    };
+
+    /** A 2D world of polygonal walls for LidarSimulator to ray-cast against.
+     */
+    class World {
+        std::vector<Segment> walls;
+
+    public:
+        /** Constructs an empty world. */
+        World() {}
+
+        /** Adds the edges of the polygon with the given `vertices`, closing it
+         * if `closed` is set. Units: meters. */
+        void add_polygon(const std::vector<icp::Vector>& vertices,
+            bool closed = true);
+
+        /** All walls in the world. */
+        const std::vector<Segment>& segments() const;
+
+        /** A `width` by `height` room centered at the origin with
+         * `obstacles` randomly placed boxes, reproducible from `seed`. A
+         * room too small to keep the boxes clear of the center has fewer. */
+        static World room(double width, double height, size_t obstacles,
+            unsigned seed);
+    };
+
+    /** The sensor model, mirroring the fields of `sensor_msgs::LaserScan`.
+     */
+    struct LidarParams {
+        double angle_min = -M_PI;
+        double angle_max = M_PI;
+        double angle_increment = 0.00548271;
+        double range_min = 0.15;
+        double range_max = 12;
+
+        /** Standard deviation of the Gaussian range noise. Units: meters. */
+        double noise_stddev = 0;
+
+        /** Probability that a beam returns nothing. */
+        double dropout_rate = 0;
+    };
+
+    /** A simulated scan in the same format as a scan parsed by the driver.
+     */
+    struct SimulatedScan {
+        double range_max;
+        double range_min;
+        double angle_min;
+        double angle_max;
+        double angle_increment;
+
+        /** The raw range of each beam, or infinity if it returned nothing.
+         * Units: meters */
+        std::vector<double> ranges;
+
+        /** The valid returns in the sensor frame. Units: centimeters */
+        std::vector<icp::Vector> points;
+    };
+
+    /** Two scans of the same world with the transform between them. */
+    struct ScanPair {
+        SimulatedScan source;
+        SimulatedScan destination;
+
+        /** The transform taking `source.points` onto `destination.points`,
+         * i.e., the ideal result of ICP. Units: centimeters */
+        icp::RBTransform truth;
+    };
+
+    /**
+     * Headless LiDAR simulator producing scans with known ground truth, for
+     * tests and benchmarks.
+     *
+     * \par Example
+     * @code
+     * sim::LidarSimulator simulator(sim::World::room(10, 8, 5, 1),
+     *     sim::LidarParams(), 1);
+     * sim::ScanPair pair = simulator.scan_pair(icp::RBTransform(),
+     *     sim::pose(0.2, -0.1, 0.05));
+     * icp->begin(pair.source.points, pair.destination.points,
+     *     icp::RBTransform());
+     * @endcode
+     */
+    class LidarSimulator {
+        World world;
+        LidarParams params;
+        std::mt19937 rng;
+
+        double cast(const icp::Vector& origin,
+            const icp::Vector& direction) const;
+
+    public:
+        /** Constructs a simulator of `world` using sensor `params`, whose
+         * noise and dropouts are reproducible from `seed`. */
+        LidarSimulator(World world, LidarParams params, unsigned seed);
+
+        /** Scans the world from `pose`, the sensor frame in the world frame.
+         * Units: meters */
+        SimulatedScan scan(const icp::RBTransform& pose);
+
+        /** Scans the world from `source_pose` and then `destination_pose`.
+         * Units: meters */
+        ScanPair scan_pair(const icp::RBTransform& source_pose,
+            const icp::RBTransform& destination_pose);
+    };
+
+    /** The pose at (`x`, `y`) rotated by `theta` radians. */
+    icp::RBTransform pose(double x, double y, double theta);
+}
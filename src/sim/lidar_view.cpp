@@ -4,6 +4,7 @@
  */
 
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
 #include <random>
 #include "util/logger.h"
@@ -17,7 +18,12 @@
 LidarView::LidarView(std::vector<icp::Vector> source,
     std::vector<icp::Vector> destination, const std::string method,
     const icp::ICP::Config& config)
-    : source(source), destination(destination), keyboard(false), iterations{} {
+    : source(source),
+      destination(destination),
+      keyboard(false),
+      is_iterating(false),
+      show_overlay(true),
+      iterations{} {
     icp = icp::ICP::from_method(method, config);
     icp->begin(source, destination, icp::RBTransform());
 }
@@ -27,7 +33,16 @@ LidarView::~LidarView() noexcept {
 }
 
 void LidarView::step() {
+    // Only the iteration itself is timed; the cost is read after the clock
+    auto start = std::chrono::steady_clock::now();
     icp->iterate();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()
+                                            - start;
+
+    // Computing the cost takes another pass over the points, so it is only
+    // measured while it is graphed
+    overlay.add_iteration(elapsed.count(),
+        show_overlay ? icp->calculate_cost() : NAN);
     iterations++;
 }
 
@@ -35,10 +50,12 @@ void LidarView::on_event(const SDL_Event& event) {
     bool space_before = keyboard.query(SDLK_SPACE);
     bool d_before = keyboard.query(SDLK_d);
     bool i_before = keyboard.query(SDLK_i);
+    bool p_before = keyboard.query(SDLK_p);
     keyboard.update(event);
     bool space_after = keyboard.query(SDLK_SPACE);
     bool d_after = keyboard.query(SDLK_d);
     bool i_after = keyboard.query(SDLK_i);
+    bool p_after = keyboard.query(SDLK_p);
 
     if (!space_before && space_after) {
         is_iterating = !is_iterating;
@@ -46,6 +63,9 @@ void LidarView::on_event(const SDL_Event& event) {
     if (!i_before && i_after) {
         step();
     }
+    if (!p_before && p_after) {
+        show_overlay = !show_overlay;
+    }
     if (!d_before && d_after) {
         std::cerr << "DEBUG PRINT:\n";
         std::cerr << "icp->current_transform() = "
@@ -53,11 +73,19 @@ void LidarView::on_event(const SDL_Event& event) {
         std::cerr << "icp->calculate_cost() = " << icp->calculate_cost()
                   << '\n';
         std::cerr << "iterations = " << iterations << '\n';
+        overlay.print_summary(std::cerr);
     }
 }
 
-void LidarView::draw(SDL_Renderer* renderer, const SDL_Rect* frame __unused,
+void LidarView::draw(SDL_Renderer* renderer, const SDL_Rect* frame,
     double dtime __unused) {
+    auto now = std::chrono::steady_clock::now();
+    if (last_frame != std::chrono::steady_clock::time_point()) {
+        std::chrono::duration<double> elapsed = now - last_frame;
+        overlay.add_frame(elapsed.count());
+    }
+    last_frame = now;
+
     if (view_config::use_light_background) {
         SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
     } else {
@@ -89,6 +117,10 @@ void LidarView::draw(SDL_Renderer* renderer, const SDL_Rect* frame __unused,
     SDL_DrawCircle(renderer, b_cm.x() + view_config::x_displace,
         b_cm.y() + view_config::y_displace, 20);
 
+    if (show_overlay) {
+        overlay.draw(renderer, frame);
+    }
+
     if (is_iterating) {
         step();
     }
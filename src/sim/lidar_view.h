@@ -6,10 +6,12 @@
 #pragma once
 
 #include <SDL.h>
+#include <chrono>
 #include <vector>
 #include "gui/view.h"
 #include "util/keyboard.h"
 #include "icp/icp.h"
+#include "perf_overlay.h"
 
 class LidarView final : public View {
     std::vector<icp::Vector> source;
@@ -17,7 +19,10 @@ class LidarView final : public View {
     std::unique_ptr<icp::ICP> icp;
     Keyboard keyboard;
     bool is_iterating;
+    bool show_overlay;
     size_t iterations;
+    PerfOverlay overlay;
+    std::chrono::steady_clock::time_point last_frame;
 
     void step();
 
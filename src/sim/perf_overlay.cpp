@@ -0,0 +1,175 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "perf_overlay.h"
+#include "view_config.h"
+
+#define PANEL_MARGIN 10
+#define PANEL_PADDING 6
+#define SAMPLE_WIDTH 2
+#define RATE_HEIGHT 8
+#define TIME_HEIGHT 72
+#define COST_HEIGHT 48
+
+// Times are graphed from 10 us to 1 s, and rates from 1 to 100k per second
+#define TIME_MIN_DECADE (-5)
+#define TIME_MAX_DECADE 0
+#define RATE_MAX_DECADE 5
+
+PerfOverlay::History::History(): samples{}, count{}, next{} {}
+
+void PerfOverlay::History::add(double sample) {
+    samples[next] = sample;
+    next = (next + 1) % PERF_HISTORY;
+    count = std::min(count + 1, (size_t)PERF_HISTORY);
+}
+
+double PerfOverlay::History::operator[](size_t i) const {
+    return samples[(next + PERF_HISTORY - count + i) % PERF_HISTORY];
+}
+
+double PerfOverlay::History::mean() const {
+    double sum{};
+    for (size_t i = 0; i < count; i++) {
+        sum += (*this)[i];
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+double PerfOverlay::History::max() const {
+    double result{};
+    for (size_t i = 0; i < count; i++) {
+        result = std::max(result, (*this)[i]);
+    }
+    return result;
+}
+
+PerfOverlay::PerfOverlay() {}
+
+void PerfOverlay::add_iteration(double seconds, double cost) {
+    iteration_time.add(seconds);
+    iteration_cost.add(cost);
+}
+
+void PerfOverlay::add_frame(double seconds) {
+    frame_time.add(seconds);
+}
+
+double PerfOverlay::iterations_per_second() const {
+    double mean = iteration_time.mean();
+    return mean > 0 ? 1 / mean : 0;
+}
+
+void PerfOverlay::print_summary(std::ostream& out) const {
+    out << "mean iteration time = " << iteration_time.mean() * 1e3 << " ms ("
+        << iterations_per_second() << " iterations/s, worst "
+        << iteration_time.max() * 1e3 << " ms)\n";
+    out << "mean frame time = " << frame_time.mean() * 1e3 << " ms\n";
+}
+
+/** The height in [0, 1] of `seconds` on the logarithmic time axis. */
+static double time_height(double seconds) {
+    if (seconds <= 0) {
+        return 0;
+    }
+    double height = (std::log10(seconds) - TIME_MIN_DECADE)
+                    / (TIME_MAX_DECADE - TIME_MIN_DECADE);
+    return std::clamp(height, 0.0, 1.0);
+}
+
+void PerfOverlay::draw_time_graph(SDL_Renderer* renderer,
+    const SDL_Rect& area, const History& history) const {
+    int bottom = area.y + area.h;
+    for (size_t i = 1; i < history.count; i++) {
+        int x = area.x + (int)i * SAMPLE_WIDTH;
+        SDL_RenderDrawLine(renderer, x - SAMPLE_WIDTH,
+            bottom - (int)(time_height(history[i - 1]) * area.h), x,
+            bottom - (int)(time_height(history[i]) * area.h));
+    }
+}
+
+void PerfOverlay::draw_cost_graph(SDL_Renderer* renderer,
+    const SDL_Rect& area) const {
+    // The cost is scaled to the window so that its shape, not its units, shows
+    double max_cost = iteration_cost.max();
+    if (max_cost <= 0 || !std::isfinite(max_cost)) {
+        return;
+    }
+    int bottom = area.y + area.h;
+    for (size_t i = 1; i < iteration_cost.count; i++) {
+        if (!std::isfinite(iteration_cost[i - 1])
+            || !std::isfinite(iteration_cost[i])) {
+            continue;
+        }
+        int x = area.x + (int)i * SAMPLE_WIDTH;
+        SDL_RenderDrawLine(renderer, x - SAMPLE_WIDTH,
+            bottom - (int)(iteration_cost[i - 1] / max_cost * area.h), x,
+            bottom - (int)(iteration_cost[i] / max_cost * area.h));
+    }
+}
+
+void PerfOverlay::draw_rate_bar(SDL_Renderer* renderer,
+    const SDL_Rect& area) const {
+    double rate = iterations_per_second();
+    double fraction = rate > 1 ? std::log10(rate) / RATE_MAX_DECADE : 0;
+    SDL_Rect bar{area.x, area.y,
+        (int)(std::clamp(fraction, 0.0, 1.0) * area.w), area.h};
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderFillRect(renderer, &bar);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 120);
+    for (int decade = 1; decade < RATE_MAX_DECADE; decade++) {
+        int x = area.x + decade * area.w / RATE_MAX_DECADE;
+        SDL_RenderDrawLine(renderer, x, area.y, x, area.y + area.h);
+    }
+}
+
+void PerfOverlay::draw(SDL_Renderer* renderer, const SDL_Rect* frame) const {
+    SDL_Rect bounds = frame ? *frame
+                            : SDL_Rect{0, 0, view_config::window_width,
+                                  view_config::window_height};
+    const int width = PERF_HISTORY * SAMPLE_WIDTH;
+    const int height = RATE_HEIGHT + TIME_HEIGHT + COST_HEIGHT
+                       + 2 * PANEL_PADDING;
+    SDL_Rect panel{bounds.x + PANEL_MARGIN,
+        bounds.y + bounds.h - PANEL_MARGIN - height - 2 * PANEL_PADDING,
+        width + 2 * PANEL_PADDING, height + 2 * PANEL_PADDING};
+
+    // The panel and gridlines are translucent, which the renderer only
+    // honors while blending, so the caller's mode is restored afterward
+    SDL_BlendMode previous_mode;
+    SDL_GetRenderDrawBlendMode(renderer, &previous_mode);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+    SDL_RenderFillRect(renderer, &panel);
+
+    SDL_Rect rate{panel.x + PANEL_PADDING, panel.y + PANEL_PADDING, width,
+        RATE_HEIGHT};
+    SDL_Rect time{rate.x, rate.y + rate.h + PANEL_PADDING, width,
+        TIME_HEIGHT};
+    SDL_Rect cost{rate.x, time.y + time.h + PANEL_PADDING, width,
+        COST_HEIGHT};
+
+    draw_rate_bar(renderer, rate);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 60);
+    for (int decade = TIME_MIN_DECADE + 1; decade < TIME_MAX_DECADE;
+         decade++) {
+        int y = time.y + time.h
+                - (int)(time_height(std::pow(10.0, decade)) * time.h);
+        SDL_RenderDrawLine(renderer, time.x, y, time.x + time.w, y);
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 255, 255, SDL_ALPHA_OPAQUE);
+    draw_time_graph(renderer, time, frame_time);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 0, SDL_ALPHA_OPAQUE);
+    draw_time_graph(renderer, time, iteration_time);
+
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, SDL_ALPHA_OPAQUE);
+    draw_cost_graph(renderer, cost);
+
+    SDL_SetRenderDrawBlendMode(renderer, previous_mode);
+}
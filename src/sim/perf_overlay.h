@@ -0,0 +1,67 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <cstddef>
+#include <ostream>
+
+/** The number of iterations (and frames) shown by the overlay graphs. */
+#define PERF_HISTORY 120
+
+/**
+ * Records the time and cost of recent ICP iterations along with the render
+ * frame time, and draws them as rolling graphs on top of a view.
+ *
+ * Recording only writes into fixed ring buffers, so it neither allocates nor
+ * touches the renderer. Times are graphed on a logarithmic scale with a
+ * gridline every decade (0.1 ms, 1 ms, 10 ms, 100 ms), so that the same
+ * height always means the same time and a slower method or configuration
+ * stands out when switching between runs.
+ */
+class PerfOverlay {
+    /** A fixed-size ring of the most recent samples. */
+    struct History {
+        double samples[PERF_HISTORY];
+        size_t count;
+        size_t next;
+
+        History();
+        void add(double sample);
+        /** The `i`th sample, oldest first. */
+        double operator[](size_t i) const;
+        double mean() const;
+        double max() const;
+    };
+
+    History iteration_time;
+    History iteration_cost;
+    History frame_time;
+
+    void draw_time_graph(SDL_Renderer* renderer, const SDL_Rect& area,
+        const History& history) const;
+    void draw_cost_graph(SDL_Renderer* renderer, const SDL_Rect& area) const;
+    void draw_rate_bar(SDL_Renderer* renderer, const SDL_Rect& area) const;
+
+public:
+    PerfOverlay();
+
+    /** Records an iteration that took `seconds` and left the given `cost`,
+     * which may be `NAN` if it was not measured. */
+    void add_iteration(double seconds, double cost);
+
+    /** Records a render frame that took `seconds`. */
+    void add_frame(double seconds);
+
+    /** Iterations per second of ICP time over the recorded iterations. */
+    double iterations_per_second() const;
+
+    /** Writes the mean iteration time, iteration rate, and frame time. */
+    void print_summary(std::ostream& out) const;
+
+    /** Draws the overlay panel in the bottom-left corner of `frame`. */
+    void draw(SDL_Renderer* renderer, const SDL_Rect* frame) const;
+};
@@ -0,0 +1,113 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <cassert>
+#include <cstdlib>
+#include "util/logger.h"
+#include "util/keyboard.h"
+#include "replay_view.h"
+#include "geo/midpoint.h"
+#include "view_config.h"
+
+#define CIRCLE_RADIUS 3
+
+ReplayView::ReplayView(const icp::IterationTrace& trace)
+    : trace(trace),
+      keyboard(false),
+      is_playing(false),
+      show_matches(trace.has_matches()),
+      frame{} {}
+
+ReplayView::~ReplayView() noexcept {}
+
+void ReplayView::step() {
+    if (frame + 1 < trace.frame_count()) {
+        frame++;
+    } else {
+        is_playing = false;
+    }
+}
+
+void ReplayView::on_event(const SDL_Event& event) {
+    bool space_before = keyboard.query(SDLK_SPACE);
+    bool d_before = keyboard.query(SDLK_d);
+    bool i_before = keyboard.query(SDLK_i);
+    bool m_before = keyboard.query(SDLK_m);
+    keyboard.update(event);
+    bool space_after = keyboard.query(SDLK_SPACE);
+    bool d_after = keyboard.query(SDLK_d);
+    bool i_after = keyboard.query(SDLK_i);
+    bool m_after = keyboard.query(SDLK_m);
+
+    if (!space_before && space_after) {
+        is_playing = !is_playing;
+    }
+    if (!i_before && i_after) {
+        step();
+    }
+    if (!m_before && m_after) {
+        show_matches = !show_matches && trace.has_matches();
+    }
+    if (!d_before && d_after && trace.frame_count() > 0) {
+        std::cerr << "DEBUG PRINT:\n";
+        std::cerr << "frame.transform = "
+                  << trace.frame(frame).transform.to_string() << '\n';
+        std::cerr << "frame.start = "
+                  << trace.frame(frame).start.to_string() << '\n';
+        std::cerr << "frame.cost = " << trace.frame(frame).cost << '\n';
+        std::cerr << "iterations = " << (frame + 1) << '\n';
+    }
+}
+
+void ReplayView::draw(SDL_Renderer* renderer, const SDL_Rect* frame __unused,
+    double dtime __unused) {
+    if (view_config::use_light_background) {
+        SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+    } else {
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    }
+    SDL_RenderClear(renderer);
+
+    const std::vector<icp::Vector>& source = trace.source();
+    const std::vector<icp::Vector>& destination = trace.destination();
+    const icp::RBTransform transform = trace.frame_count() > 0
+                                           ? trace.frame(this->frame).transform
+                                           : icp::RBTransform();
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 255, SDL_ALPHA_OPAQUE);
+    for (const icp::Vector& point: destination) {
+        SDL_DrawCircle(renderer, point[0] + view_config::x_displace,
+            point[1] + view_config::y_displace, CIRCLE_RADIUS);
+    }
+
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, SDL_ALPHA_OPAQUE);
+    for (const icp::Vector& point: source) {
+        icp::Vector result = transform.apply_to(point);
+        SDL_DrawCircle(renderer, result[0] + view_config::x_displace,
+            result[1] + view_config::y_displace, CIRCLE_RADIUS);
+    }
+
+    // The recorded pairs were computed from the transform the frame started at
+    if (show_matches && trace.frame_count() > 0) {
+        const icp::RBTransform& matched = trace.frame(this->frame).start;
+        const uint32_t* pairs = trace.pairs(this->frame);
+        SDL_SetRenderDrawColor(renderer, 0, 255, 0, 80);
+        for (size_t i = 0; i < source.size(); i++) {
+            if (pairs[i] == icp::IterationTrace::no_pair) {
+                continue;
+            }
+            icp::Vector from = matched.apply_to(source[i]);
+            const icp::Vector& to = destination[pairs[i]];
+            SDL_RenderDrawLine(renderer, from[0] + view_config::x_displace,
+                from[1] + view_config::y_displace,
+                to[0] + view_config::x_displace,
+                to[1] + view_config::y_displace);
+        }
+    }
+
+    if (is_playing) {
+        step();
+    }
+}
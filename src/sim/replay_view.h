@@ -0,0 +1,32 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <SDL.h>
+#include <vector>
+#include "gui/view.h"
+#include "util/keyboard.h"
+#include "icp/trace.h"
+
+class ReplayView final : public View {
+    const icp::IterationTrace& trace;
+    Keyboard keyboard;
+    bool is_playing;
+    bool show_matches;
+    size_t frame;
+
+    void step();
+
+public:
+    /** Constructs a new view replaying the recorded iterations in `trace`,
+     * which must outlive the view. */
+    ReplayView(const icp::IterationTrace& trace);
+
+    ~ReplayView() noexcept override;
+    void on_event(const SDL_Event& event) override;
+    void draw(SDL_Renderer* renderer, const SDL_Rect* frame,
+        double dtime) override;
+};
@@ -0,0 +1,269 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+#include <algorithm>
+#include "tuner.h"
+
+namespace sim {
+    TuningSpace TuningSpace::defaults() {
+        TuningSpace space;
+        space.methods = icp::ICP::registered_methods();
+        space.burn_ins = {0, 2, 5};
+        space.convergence_thresholds = {1, 5, 20};
+        space.parameters = {
+            {"overlap_rate", {0.7, 0.85, 1}, false, {"trimmed", "test1"}},
+            {"cell_size", {50, 100, 200}, false, {"ndt"}},
+            {"anderson_depth", {0, 3}, true, {}},
+        };
+        return space;
+    }
+
+    Tuner::Tuner(std::vector<ScanPair> pairs): pairs(std::move(pairs)) {}
+
+    std::vector<ScanPair> Tuner::random_pairs(LidarSimulator& simulator,
+        size_t count, double max_translation, double max_rotation,
+        unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> position(-1, 1);
+        std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+        std::uniform_real_distribution<double> unit(-1, 1);
+        std::vector<ScanPair> pairs;
+        for (size_t i = 0; i < count; i++) {
+            const double x = position(rng);
+            const double y = position(rng);
+            const double theta = angle(rng);
+            pairs.push_back(simulator.scan_pair(pose(x, y, theta),
+                pose(x + max_translation * unit(rng),
+                    y + max_translation * unit(rng),
+                    theta + max_rotation * unit(rng))));
+        }
+        return pairs;
+    }
+
+    /** The parameters in `space` that `method` reads. */
+    static std::vector<const TuningParameter*> parameters_of(
+        const TuningSpace& space, const std::string& method) {
+        std::vector<const TuningParameter*> parameters;
+        for (const TuningParameter& parameter: space.parameters) {
+            if (parameter.methods.empty()
+                || std::find(parameter.methods.begin(),
+                       parameter.methods.end(), method)
+                       != parameter.methods.end()) {
+                parameters.push_back(&parameter);
+            }
+        }
+        return parameters;
+    }
+
+    /** The candidate choosing, in order, the burn-in, the threshold, and
+     * then each parameter's value at the indices in `choice`. */
+    static TuningCandidate make_candidate(const TuningSpace& space,
+        const std::string& method,
+        const std::vector<const TuningParameter*>& parameters,
+        const std::vector<size_t>& choice) {
+        TuningCandidate candidate;
+        candidate.method = method;
+        candidate.burn_in = space.burn_ins[choice[0]];
+        candidate.convergence_threshold =
+            space.convergence_thresholds[choice[1]];
+
+        std::stringstream description;
+        description << method << " burn_in=" << candidate.burn_in
+                    << " threshold=" << candidate.convergence_threshold;
+        for (size_t k = 0; k < parameters.size(); k++) {
+            const TuningParameter& parameter = *parameters[k];
+            const double value = parameter.values[choice[k + 2]];
+            if (parameter.is_integer) {
+                candidate.config.set(parameter.key, (int)value);
+            } else {
+                candidate.config.set(parameter.key, value);
+            }
+            description << ' ' << parameter.key << '=' << value;
+        }
+        candidate.description = description.str();
+        return candidate;
+    }
+
+    /** The number of values along each dimension of a candidate. */
+    static std::vector<size_t> dimensions_of(const TuningSpace& space,
+        const std::vector<const TuningParameter*>& parameters) {
+        std::vector<size_t> dimensions = {space.burn_ins.size(),
+            space.convergence_thresholds.size()};
+        for (const TuningParameter* parameter: parameters) {
+            dimensions.push_back(parameter->values.size());
+        }
+        return dimensions;
+    }
+
+    std::vector<TuningCandidate> Tuner::grid(const TuningSpace& space) {
+        std::vector<TuningCandidate> candidates;
+        for (const std::string& method: space.methods) {
+            const std::vector<const TuningParameter*> parameters =
+                parameters_of(space, method);
+            const std::vector<size_t> dimensions = dimensions_of(space,
+                parameters);
+            if (std::find(dimensions.begin(), dimensions.end(), 0)
+                != dimensions.end()) {
+                continue;
+            }
+
+            // Count through every choice like an odometer
+            std::vector<size_t> choice(dimensions.size(), 0);
+            for (;;) {
+                candidates.push_back(
+                    make_candidate(space, method, parameters, choice));
+                size_t k = 0;
+                while (k < choice.size() && ++choice[k] == dimensions[k]) {
+                    choice[k++] = 0;
+                }
+                if (k == choice.size()) {
+                    break;
+                }
+            }
+        }
+        return candidates;
+    }
+
+    std::vector<TuningCandidate> Tuner::random(const TuningSpace& space,
+        size_t count, unsigned seed) {
+        std::vector<TuningCandidate> candidates;
+        if (space.methods.empty()) {
+            return candidates;
+        }
+
+        // Stop short of `count` if the space runs out of new candidates
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> pick_method(0,
+            space.methods.size() - 1);
+        std::unordered_set<std::string> seen;
+        for (size_t attempt = 0;
+             candidates.size() < count && attempt < 10 * count; attempt++) {
+            const std::string& method = space.methods[pick_method(rng)];
+            const std::vector<const TuningParameter*> parameters =
+                parameters_of(space, method);
+            const std::vector<size_t> dimensions = dimensions_of(space,
+                parameters);
+            std::vector<size_t> choice;
+            for (size_t dimension: dimensions) {
+                if (dimension == 0) {
+                    break;
+                }
+                choice.push_back(std::uniform_int_distribution<size_t>(0,
+                    dimension - 1)(rng));
+            }
+            if (choice.size() < dimensions.size()) {
+                continue;
+            }
+            TuningCandidate candidate = make_candidate(space, method,
+                parameters, choice);
+            if (seen.insert(candidate.description).second) {
+                candidates.push_back(std::move(candidate));
+            }
+        }
+        return candidates;
+    }
+
+    std::vector<TuningResult> Tuner::evaluate(
+        const std::vector<TuningCandidate>& candidates, size_t threads) const {
+        std::vector<TuningResult> results(candidates.size());
+        std::atomic<size_t> next(0);
+
+        auto work = [&]() {
+            for (size_t i = next++; i < candidates.size(); i = next++) {
+                const TuningCandidate& candidate = candidates[i];
+                std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(
+                    candidate.method, candidate.config);
+
+                TuningResult& result = results[i];
+                result = TuningResult{candidate, 0, 0, 0};
+                for (const ScanPair& pair: pairs) {
+                    const auto start = std::chrono::steady_clock::now();
+                    icp->begin(pair.source.points, pair.destination.points,
+                        icp::RBTransform());
+                    icp::ICP::ConvergenceReport report = icp->converge(
+                        candidate.burn_in, candidate.convergence_threshold);
+                    const std::chrono::duration<double> diff =
+                        std::chrono::steady_clock::now() - start;
+
+                    const icp::RBTransform& transform =
+                        icp->current_transform();
+                    double sum_squares = 0;
+                    for (const icp::Vector& point: pair.source.points) {
+                        sum_squares += (transform.apply_to(point)
+                                           - pair.truth.apply_to(point))
+                                           .squaredNorm();
+                    }
+                    result.latency += diff.count();
+                    result.error += std::sqrt(
+                        sum_squares / std::max<size_t>(
+                            pair.source.points.size(), 1));
+                    result.iterations += report.iteration_count;
+                }
+                const double count = std::max<size_t>(pairs.size(), 1);
+                result.latency /= count;
+                result.error /= count;
+                result.iterations /= count;
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; t++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker: workers) {
+            worker.join();
+        }
+        return results;
+    }
+
+    std::vector<size_t> Tuner::pareto_front(
+        const std::vector<TuningResult>& results) {
+        std::vector<size_t> order(results.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+            return results[i].latency < results[j].latency
+                   || (results[i].latency == results[j].latency
+                       && results[i].error < results[j].error);
+        });
+
+        // Faster results come first, so a result is on the front exactly
+        // when it is more accurate than all of them
+        std::vector<size_t> front;
+        double best_error = INFINITY;
+        for (size_t i: order) {
+            if (results[i].error < best_error) {
+                best_error = results[i].error;
+                front.push_back(i);
+            }
+        }
+        return front;
+    }
+
+    size_t Tuner::recommend(const std::vector<TuningResult>& results,
+        double max_error) {
+        size_t fastest = results.size();
+        size_t most_accurate = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].error <= max_error
+                && (fastest == results.size()
+                    || results[i].latency < results[fastest].latency)) {
+                fastest = i;
+            }
+            if (results[i].error < results[most_accurate].error) {
+                most_accurate = i;
+            }
+        }
+        return fastest < results.size() ? fastest : most_accurate;
+    }
+}
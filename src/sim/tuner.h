@@ -0,0 +1,122 @@
+/*
+ * @author Ethan Uppal
+ * @copyright Copyright (C) 2024 Ethan Uppal. All rights reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "icp/icp.h"
+#include "lidar_sim.h"
+
+namespace sim {
+    /** A value of a configuration parameter to try. */
+    struct TuningParameter {
+        /** The ICP::Config key. */
+        std::string key;
+
+        /** The values to try, set as an `int` if `is_integer`. */
+        std::vector<double> values;
+        bool is_integer;
+
+        /** The methods that read the parameter, or empty for all. */
+        std::vector<std::string> methods;
+    };
+
+    /** The configurations a Tuner chooses among. */
+    struct TuningSpace {
+        std::vector<std::string> methods;
+        std::vector<size_t> burn_ins;
+        std::vector<double> convergence_thresholds;
+        std::vector<TuningParameter> parameters;
+
+        /** The registered methods with the parameters that matter most. */
+        static TuningSpace defaults();
+    };
+
+    /** One configuration to evaluate. */
+    struct TuningCandidate {
+        std::string method;
+        icp::ICP::Config config;
+        size_t burn_in;
+        double convergence_threshold;
+
+        /** The method and every chosen value, e.g., `"trimmed burn_in=2
+         * threshold=5 overlap_rate=0.85"`. */
+        std::string description;
+    };
+
+    /** How a candidate performed. */
+    struct TuningResult {
+        TuningCandidate candidate;
+
+        /** The mean time of ICP::begin and ICP::converge per pair. Units:
+         * seconds. */
+        double latency;
+
+        /** The mean over pairs of the RMS distance between the source points
+         * placed by the result and by the ground truth. Units: centimeters.
+         */
+        double error;
+
+        /** The mean iteration count per pair. */
+        double iterations;
+    };
+
+    /**
+     * Searches for configurations that align scan pairs with known ground
+     * truth both quickly and accurately.
+     *
+     * \par Example
+     * @code
+     * sim::Tuner tuner(sim::Tuner::random_pairs(simulator, 8, 0.3, 0.15, 1));
+     * std::vector<sim::TuningResult> results = tuner.evaluate(
+     *     sim::Tuner::grid(sim::TuningSpace::defaults()), 8);
+     * for (size_t i: sim::Tuner::pareto_front(results)) { ... }
+     * const sim::TuningResult& best = results[sim::Tuner::recommend(results,
+     *     2.0)];
+     * @endcode
+     */
+    class Tuner {
+        std::vector<ScanPair> pairs;
+
+    public:
+        /** Constructs a tuner evaluating candidates on `pairs`. */
+        Tuner(std::vector<ScanPair> pairs);
+
+        /** `count` pairs scanned from random poses with `simulator`, the
+         * destination moved from the source by up to `max_translation`
+         * meters and `max_rotation` radians, reproducible from `seed`. */
+        static std::vector<ScanPair> random_pairs(LidarSimulator& simulator,
+            size_t count, double max_translation, double max_rotation,
+            unsigned seed);
+
+        /** Every combination of values in `space`. */
+        static std::vector<TuningCandidate> grid(const TuningSpace& space);
+
+        /** `count` combinations of values in `space` chosen uniformly at
+         * random, reproducible from `seed`. */
+        static std::vector<TuningCandidate> random(const TuningSpace& space,
+            size_t count, unsigned seed);
+
+        /** Evaluates every candidate on every pair using `threads` threads.
+         * Candidates are timed while others run, so latencies are best
+         * compared among themselves. */
+        std::vector<TuningResult> evaluate(
+            const std::vector<TuningCandidate>& candidates,
+            size_t threads) const;
+
+        /** The indices of the results not beaten in both latency and error
+         * by any other, in order of increasing latency. */
+        static std::vector<size_t> pareto_front(
+            const std::vector<TuningResult>& results);
+
+        /** The index of the fastest result with an error of at most
+         * `max_error`, or of the most accurate if there is none.
+         *
+         * @pre `results` is not empty. */
+        static size_t recommend(const std::vector<TuningResult>& results,
+            double max_error);
+    };
+}
@@ -1,17 +1,192 @@
 // Copyright (C) 2024 Ethan Uppal. All rights reserved.
 
+#include <thread>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <new>
+
 extern "C" {
 #include <simple_test/simple_test.h>
 }
 
 #include "icp/icp.h"
+#include "icp/trace.h"
+#include "icp/polar.h"
+#include "icp/pipeline.h"
+#include "icp/distance_field.h"
+#include "icp/timeline.h"
+#include "icp/scan_log.h"
+#include "icp/features.h"
+#include "icp/initial_guess.h"
+#include "algo/quickselect.h"
+#include "algo/space_filling.h"
+#include "sim/lidar_sim.h"
+#include "sim/tuner.h"
 
 #define BURN_IN 0
 #define TRANS_EPS 2
 #define RAD_EPS ((double)(1e-1))
 
+/** The number of heap allocations made so far. */
+static std::atomic<size_t> allocation_count(0);
+
+void* operator new(size_t size) {
+    allocation_count++;
+    if (void* pointer = malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
 void test_kdtree(void) {}
 
+void test_multiselect(void) {
+    std::vector<int> values;
+    for (int i = 0; i < 100; i++) {
+        values.push_back((i * 37) % 100);
+    }
+    std::vector<size_t> ranks = {0, 10, 11, 50, 99};
+    multiselect(values.begin(), values.end(), ranks.begin(), ranks.end(),
+        std::less<int>());
+    for (size_t rank: ranks) {
+        assert_equal((int)rank, values[rank]);
+    }
+    for (int i = 0; i < 50; i++) {
+        assert_true(values[i] < 50);
+    }
+}
+
+void test_adaptive_overlap(void) {
+    icp::ICP::Config config;
+    config.set("adaptive_overlap", 1);
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("trimmed", config);
+
+    // b is a rotated copy of a, except for a few outliers in a placed
+    // symmetrically so they do not shift its centroid
+    const double angle = 0.1;
+    icp::Matrix rotation_matrix{
+        {cos(angle), -sin(angle)}, {sin(angle), cos(angle)}};
+    std::vector<icp::Vector> a, b;
+    for (int i = 0; i < 40; i++) {
+        icp::Vector point(100 * cos(i * M_PI / 20), 50 * sin(i * M_PI / 20));
+        a.push_back(point);
+        b.push_back(rotation_matrix * point);
+    }
+    for (int i = 0; i < 4; i++) {
+        a.push_back(icp::Vector(i % 2 ? 200 : -200, i / 2 ? 60 : -60));
+    }
+
+    icp->begin(a, b, icp::RBTransform());
+    icp->converge(BURN_IN, 0);
+    const icp::Matrix& result = icp->current_transform().rotation;
+    assert_true(fabs(atan2(result(1, 0), result(0, 0)) - angle) < 1e-3);
+}
+
+void test_simulator(void) {
+    sim::LidarParams params;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, 5, 1), params, 1);
+
+    // rotating the sensor in place by whole beams shifts the ranges
+    const size_t shift = 10;
+    sim::ScanPair pair = simulator.scan_pair(sim::pose(0.5, 0.2, 0),
+        sim::pose(0.5, 0.2, shift * params.angle_increment));
+    const std::vector<double>& source = pair.source.ranges;
+    const std::vector<double>& destination = pair.destination.ranges;
+    assert_equal(source.size(), destination.size());
+    assert_equal(source.size(), pair.source.points.size());
+    for (size_t i = 0; i + shift < source.size(); i++) {
+        assert_true(fabs(destination[i] - source[i + shift]) < 1e-6);
+    }
+    assert_true(pair.truth.translation.norm() < 1e-9);
+    assert_true(fabs(pair.truth.rotation(1, 0)
+                     + sin(shift * params.angle_increment))
+                < 1e-9);
+
+    // the ground truth maps every source point onto a destination point
+    params.angle_increment = M_PI / 180;
+    simulator = sim::LidarSimulator(sim::World::room(10, 8, 5, 1), params, 1);
+    pair = simulator.scan_pair(sim::pose(0, 0, 0), sim::pose(0, 0, M_PI / 18));
+    for (const icp::Vector& point: pair.source.points) {
+        icp::Vector moved = pair.truth.apply_to(point);
+        double closest = INFINITY;
+        for (const icp::Vector& other: pair.destination.points) {
+            closest = std::min(closest, (moved - other).norm());
+        }
+        assert_true(closest < 1e-6);
+    }
+
+    // rooms too small for their obstacles have fewer, or only walls
+    assert_equal(4, sim::World::room(2, 2, 1, 1).segments().size());
+    assert_equal(4, sim::World::room(0.5, 0.5, 3, 1).segments().size());
+
+    // dropouts are reproducible and occur at about the requested rate
+    params.dropout_rate = 0.25;
+    sim::LidarSimulator first(sim::World::room(10, 8, 5, 1), params, 2);
+    sim::LidarSimulator second(sim::World::room(10, 8, 5, 1), params, 2);
+    sim::SimulatedScan scan = first.scan(sim::pose(0, 0, 0));
+    assert_equal(scan.points, second.scan(sim::pose(0, 0, 0)).points);
+    double rate = 1 - (double)scan.points.size() / scan.ranges.size();
+    assert_true(rate > 0.15 && rate < 0.35);
+}
+
+/** Scans of the room used throughout these tests, with `obstacles` obstacles,
+ * taken by a noisy sensor from the origin and from `destination`. */
+static sim::ScanPair simulated_pair(
+    const icp::RBTransform& destination = sim::pose(0.2, -0.1, 0.05),
+    size_t obstacles = 5,
+    double angle_increment = sim::LidarParams().angle_increment) {
+    sim::LidarParams params;
+    params.angle_increment = angle_increment;
+    params.noise_stddev = 0.01;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, obstacles, 1),
+        params, 1);
+    return simulator.scan_pair(sim::pose(0, 0, 0), destination);
+}
+
+void test_polar(void) {
+    const icp::ScanGeometry geometry{-M_PI, M_PI / 90, 0.15, 12};
+    std::vector<float> ranges;
+    for (size_t i = 0; i < 180; i++) {
+        ranges.push_back(i % 7 == 0 ? NAN : i % 11 == 0 ? 20 : 1 + i / 60.0f);
+    }
+
+    icp::PolarConverter converter(100);
+    std::vector<icp::Vector> points;
+    for (int repeat = 0; repeat < 2; repeat++) {
+        size_t count = converter.convert(ranges.data(), ranges.size(),
+            geometry, points);
+        assert_equal(count, points.size());
+
+        size_t j = 0;
+        for (size_t i = 0; i < ranges.size(); i++) {
+            if (!(ranges[i] >= geometry.range_min
+                    && ranges[i] <= geometry.range_max)) {
+                continue;
+            }
+            double angle = geometry.angle_min + i * geometry.angle_increment;
+            double range = ranges[i];
+            icp::Vector expected(100 * range * cos(angle),
+                100 * range * sin(angle));
+            assert_true((points[j] - expected).norm() < 1e-9);
+            j++;
+        }
+        assert_equal(j, count);
+    }
+}
+
 void test_icp(const std::string& method) {
     std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method);
 
@@ -81,10 +256,1031 @@ void test_icp(const std::string& method) {
     }
 }
 
+/** Flips a byte `offset` bytes into the file at `path`. */
+static void corrupt_file(const std::string& path, long offset) {
+    FILE* file = fopen(path.c_str(), "r+b");
+    fseek(file, offset, SEEK_SET);
+    int byte = fgetc(file);
+    fseek(file, offset, SEEK_SET);
+    fputc(byte ^ 0xff, file);
+    fclose(file);
+}
+
+void test_trace(const std::string& method) {
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method);
+
+    std::vector<icp::Vector> a = {icp::Vector(0, 0), icp::Vector(0, 100)};
+    std::vector<icp::Vector> b = {icp::Vector(100, 0), icp::Vector(100, 100)};
+    icp::IterationTrace trace(true);
+    icp->record(&trace);
+    icp->begin(a, b, icp::RBTransform());
+    icp::ICP::ConvergenceReport result = icp->converge(BURN_IN, 0);
+
+    // every accepted iteration is recorded, ending at the final transform
+    assert_equal(result.iteration_count, trace.frame_count());
+    assert_equal(2, trace.source().size());
+    assert_equal(2, trace.destination().size());
+    const icp::IterationTrace::Frame& last = trace.frame(
+        trace.frame_count() - 1);
+    assert_true((last.transform.translation
+                    - icp->current_transform().translation)
+                    .norm()
+                < 1e-9);
+    assert_equal(result.final_cost, last.cost);
+    for (size_t i = 1; i < trace.frame_count(); i++) {
+        assert_true((trace.frame(i).start.translation
+                        - trace.frame(i - 1).transform.translation)
+                        .norm()
+                    < 1e-9);
+    }
+
+    // a saved trace loads back identically, up to float point storage
+    const char* path = "_temp_trace.icptrace";
+    assert_true(trace.save(path));
+    icp::IterationTrace loaded;
+    assert_true(icp::IterationTrace::load(path, loaded));
+    assert_true(loaded.has_matches());
+    assert_equal(trace.frame_count(), loaded.frame_count());
+    for (size_t i = 0; i < trace.frame_count(); i++) {
+        assert_equal(trace.frame(i).cost, loaded.frame(i).cost);
+        assert_true((trace.frame(i).transform.rotation
+                        - loaded.frame(i).transform.rotation)
+                        .norm()
+                    < 1e-9);
+        assert_true((trace.frame(i).start.translation
+                        - loaded.frame(i).start.translation)
+                        .norm()
+                    < 1e-3);
+        for (size_t j = 0; j < a.size(); j++) {
+            assert_equal(trace.pairs(i)[j], loaded.pairs(i)[j]);
+            assert_true(loaded.pairs(i)[j] < b.size());
+        }
+    }
+
+    // counts that disagree with the size of the file are rejected before
+    // anything is allocated for them
+    corrupt_file(path, 4 + 3 * sizeof(uint32_t) + 3);
+    assert_true(!icp::IterationTrace::load(path, loaded));
+    assert_true(trace.save(path));
+    assert_true(truncate(path, 40) == 0);
+    assert_true(!icp::IterationTrace::load(path, loaded));
+    remove(path);
+}
+
+void test_ndt(void) {
+    sim::ScanPair pair = simulated_pair(sim::pose(0.2, -0.1, 0.05), 6);
+
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("ndt");
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp->converge(5, 0);
+
+    const icp::RBTransform& result = icp->current_transform();
+    const icp::Matrix error = pair.truth.rotation.transpose()
+                              * result.rotation;
+    assert_true((result.translation - pair.truth.translation).norm()
+                <= TRANS_EPS);
+    assert_true(fabs(atan2(error(1, 0), error(0, 0))) < 1e-2);
+}
+
+void test_anderson(void) {
+    sim::ScanPair pair = simulated_pair(sim::pose(0.2, -0.1, 0.05), 6);
+
+    icp::ICP::Config config;
+    std::unique_ptr<icp::ICP> plain = icp::ICP::from_method("vanilla", config);
+    config.set("anderson_depth", 3);
+    std::unique_ptr<icp::ICP> accelerated = icp::ICP::from_method("vanilla",
+        config);
+
+    plain->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    accelerated->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport plain_result = plain->converge(BURN_IN, 0);
+    icp::ICP::ConvergenceReport accelerated_result = accelerated->converge(
+        BURN_IN, 0);
+
+    // the same fixed point is reached in fewer iterations
+    assert_true(accelerated_result.final_cost
+                <= plain_result.final_cost + 1e-6);
+    assert_true(accelerated_result.iteration_count
+                < plain_result.iteration_count);
+}
+
+void test_lazy_matching(const std::string& method) {
+    sim::ScanPair pair = simulated_pair();
+
+    icp::ICP::Config config;
+    std::unique_ptr<icp::ICP> full = icp::ICP::from_method(method, config);
+    config.set("lazy_matching", 1);
+    std::unique_ptr<icp::ICP> lazy = icp::ICP::from_method(method, config);
+
+    // reusing matches must not change the outcome of any iteration
+    full->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    lazy->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    for (int i = 0; i < 10; i++) {
+        full->iterate();
+        lazy->iterate();
+        assert_equal(full->calculate_cost(), lazy->calculate_cost());
+        assert_true((full->current_transform().translation
+                        - lazy->current_transform().translation)
+                        .norm()
+                    < 1e-9);
+    }
+
+    // methods that match otherwise never consult the reused matches
+    if (!full->matches_by_point()) {
+        return;
+    }
+
+    // yet, as the transform settles, fewer distances are computed
+    full->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    lazy->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport full_report = full->converge(BURN_IN, 0);
+    icp::ICP::ConvergenceReport lazy_report = lazy->converge(BURN_IN, 0);
+    assert_true(lazy_report.distance_evaluations
+                < full_report.distance_evaluations * 3 / 4);
+}
+
+void test_pipeline(void) {
+    sim::LidarParams params;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, 5, 1), params, 1);
+    const icp::ScanGeometry geometry{params.angle_min, params.angle_increment,
+        params.range_min, params.range_max};
+    std::vector<icp::RBTransform> poses;
+    for (int i = 0; i < 6; i++) {
+        poses.push_back(sim::pose(0.05 * i, -0.02 * i, 0.01 * i));
+    }
+
+    // without dropping, every scan comes out in order, aligned as if by
+    // hand to the previous one starting from the previous motion
+    icp::PipelineOptions options;
+    options.queue_capacity = 2;
+    options.drop_policy = icp::DropPolicy::block;
+    options.scale = 100;
+    std::vector<icp::PipelineResult> results;
+    icp::ScanPipeline pipeline(icp::ICP::from_method("vanilla"),
+        [&](const icp::PipelineResult& result) { results.push_back(result); },
+        nullptr, options);
+    std::vector<std::vector<icp::Vector>> scans;
+    for (size_t i = 0; i < poses.size(); i++) {
+        sim::SimulatedScan scan = simulator.scan(poses[i]);
+        scans.push_back(scan.points);
+        assert_true(pipeline.push(scan.ranges.data(), scan.ranges.size(),
+            geometry, i));
+    }
+    pipeline.finish();
+    assert_equal(poses.size(), results.size());
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("vanilla");
+    for (size_t i = 1; i < results.size(); i++) {
+        assert_equal((double)i, results[i].timestamp);
+        icp->begin(scans[i], scans[i - 1], results[i - 1].relative);
+        icp->converge(options.burn_in, options.convergence_threshold);
+        const icp::RBTransform& relative = results[i].relative;
+        assert_true((relative.translation
+                        - icp->current_transform().translation)
+                        .norm()
+                    < 1e-9);
+        const icp::RBTransform& previous = results[i - 1].pose;
+        assert_true((results[i].pose.translation
+                        - previous.apply_to(relative.translation))
+                        .norm()
+                    < 1e-9);
+    }
+    icp::PipelineStats stats = pipeline.stats();
+    assert_equal(poses.size(), stats.converted.pushed);
+    assert_equal(0, stats.converted.dropped);
+    assert_true(stats.converted.max_depth <= stats.converted.capacity);
+    std::vector<double> ranges = simulator.scan(poses[0]).ranges;
+    assert_true(!pipeline.push(ranges.data(), ranges.size(), geometry, 0));
+
+    // an idle pipeline sleeps rather than spinning its three stages
+    icp::ScanPipeline idle(icp::ICP::from_method("vanilla"), nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const std::clock_t idle_start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert_true(std::clock() - idle_start < CLOCKS_PER_SEC / 50);
+    idle.finish();
+
+    // when dropping, every scan is either output or counted as dropped
+    options.drop_policy = icp::DropPolicy::drop_newest;
+    size_t output_count = 0;
+    icp::ScanPipeline dropping(icp::ICP::from_method("vanilla"),
+        [&](const icp::PipelineResult&) { output_count++; }, nullptr,
+        options);
+    for (int i = 0; i < 20; i++) {
+        dropping.push(ranges.data(), ranges.size(), geometry, i);
+    }
+    dropping.finish();
+    stats = dropping.stats();
+    assert_equal(20, stats.converted.pushed + stats.converted.dropped);
+    assert_equal(stats.converted.pushed, output_count);
+}
+
+void test_budget(void) {
+    sim::ScanPair pair = simulated_pair(sim::pose(0.3, -0.2, 0.1));
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("vanilla");
+    const size_t n = pair.source.points.size();
+    const size_t m = pair.destination.points.size();
+
+    // without a budget, the report says it converged
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport full = icp->converge(BURN_IN, 0);
+    assert_true(full.stop_reason == icp::ICP::StopReason::converged);
+    assert_true(full.distance_evaluations >= full.iteration_count * n * m);
+
+    // each limit stops early, keeping the best transform so far
+    icp::ICP::Budget budget;
+    budget.max_iterations = 2;
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport result = icp->converge(BURN_IN, 0, budget);
+    assert_true(result.stop_reason == icp::ICP::StopReason::out_of_iterations);
+    assert_equal(2, result.iteration_count);
+    assert_true(result.final_cost < INFINITY);
+
+    budget = icp::ICP::Budget();
+    budget.max_distance_evaluations = 5 * n * m / 2;
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    result = icp->converge(BURN_IN, 0, budget);
+    assert_true(
+        result.stop_reason == icp::ICP::StopReason::out_of_evaluations);
+    assert_equal(2, result.iteration_count);
+    assert_true(result.distance_evaluations <= budget.max_distance_evaluations);
+
+    // only the points matched before the budget ran out are listed, none
+    // as an exact match to a placeholder
+    for (const char* method: {"vanilla", "trimmed"}) {
+        icp::ICP::Config config;
+        config.set("overlap_rate", 0.8);
+        std::unique_ptr<icp::ICP> cut = icp::ICP::from_method(method, config);
+        cut->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+        cut->converge(BURN_IN, 0, budget);
+        const size_t matched = cut->correspondences().size();
+        assert_true(matched > 0 && matched < n);
+        std::vector<bool> is_listed(n, false);
+        size_t inliers = 0;
+        for (icp::ICP::Correspondence pairing: cut->correspondences()) {
+            assert_true(!is_listed[pairing.source]);
+            is_listed[pairing.source] = true;
+            assert_true(pairing.residual > 0 && pairing.residual < INFINITY);
+            inliers += pairing.is_inlier;
+        }
+        assert_equal(method == std::string("vanilla")
+                         ? matched
+                         : (size_t)(0.8 * matched),
+            inliers);
+        assert_true(cut->covariance().allFinite());
+    }
+
+    // the deadline is overrun by well under one iteration, timed as the
+    // fastest of a few so that warmer iterations cannot fit in more
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    auto iteration = std::chrono::steady_clock::duration::max();
+    for (int i = 0; i < 3; i++) {
+        auto start = std::chrono::steady_clock::now();
+        icp->iterate();
+        iteration = std::min(iteration,
+            std::chrono::steady_clock::now() - start);
+    }
+    icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    budget = icp::ICP::Budget::within(iteration * 5 / 2);
+    result = icp->converge(BURN_IN, 0, budget);
+    auto overrun = std::chrono::steady_clock::now() - budget.deadline;
+    assert_true(result.stop_reason == icp::ICP::StopReason::out_of_time);
+    assert_true(overrun < iteration / 4);
+    assert_true(result.iteration_count <= 2);
+}
+
+void test_distance_field(void) {
+    std::vector<icp::Vector> points;
+    for (int i = 0; i < 200; i++) {
+        points.push_back(icp::Vector((i * 37) % 101 * 3.0, (i * 53) % 97));
+    }
+    icp::DistanceField field(4, 20);
+    field.build(points);
+    assert_true(field.memory_usage()
+                >= field.width() * field.height() * sizeof(uint32_t));
+
+    // lookups are exact everywhere, including far outside the field
+    for (int i = 0; i < 500; i++) {
+        icp::Vector query((i * 71) % 400 - 50.0, (i * 29) % 160 - 30.5);
+        if (i % 50 == 0) {
+            query *= 20;
+        }
+        double expected = INFINITY;
+        size_t expected_index = 0;
+        for (size_t j = 0; j < points.size(); j++) {
+            if ((points[j] - query).squaredNorm() < expected) {
+                expected = (points[j] - query).squaredNorm();
+                expected_index = j;
+            }
+        }
+        double sq_dist;
+        size_t evaluations;
+        assert_equal(expected_index,
+            field.nearest(query, sq_dist, evaluations));
+        assert_equal(expected, sq_dist);
+    }
+
+    // matching through the field does not change any iteration
+    sim::ScanPair pair = simulated_pair();
+    icp::ICP::Config config;
+    std::unique_ptr<icp::ICP> search = icp::ICP::from_method("trimmed",
+        config);
+    config.set("distance_field", 1);
+    std::unique_ptr<icp::ICP> lookup = icp::ICP::from_method("trimmed",
+        config);
+    assert_true(search->matching_field() == nullptr);
+    search->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    lookup->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    for (int i = 0; i < 10; i++) {
+        search->iterate();
+        lookup->iterate();
+        assert_equal(search->calculate_cost(), lookup->calculate_cost());
+    }
+    assert_true(lookup->matching_field()->memory_usage() > 0);
+}
+
+void test_field_cache(void) {
+    std::vector<icp::Vector> points;
+    for (int i = 0; i < 200; i++) {
+        points.push_back(icp::Vector((i * 37) % 101 * 3.0, (i * 53) % 97));
+    }
+    icp::DistanceField field(4, 20);
+    field.build(points);
+
+    // a saved field loads back identically
+    const std::string path = "_temp_field.icpfield";
+    assert_true(field.save(path));
+    icp::DistanceField loaded(4, 20);
+    assert_true(loaded.load(path));
+    assert_true(loaded.points() == points);
+    assert_equal(field.width(), loaded.width());
+    assert_equal(field.height(), loaded.height());
+    for (int i = 0; i < 100; i++) {
+        icp::Vector query((i * 71) % 400 - 50.0, (i * 29) % 160 - 30.5);
+        double sq_dist, loaded_sq_dist;
+        size_t evaluations, loaded_evaluations;
+        assert_equal(field.nearest(query, sq_dist, evaluations),
+            loaded.nearest(query, loaded_sq_dist, loaded_evaluations));
+        assert_equal(evaluations, loaded_evaluations);
+    }
+
+    // but not into a field with other parameters, nor once corrupted
+    icp::DistanceField other(5, 20);
+    assert_true(!other.load(path));
+    corrupt_file(path, 1000);
+    icp::DistanceField corrupted(4, 20);
+    assert_true(!corrupted.load(path));
+    assert_true(corrupted.points().empty());
+    remove(path.c_str());
+
+    // a cached field is built once, and rebuilt when the file goes bad
+    const std::string directory = "_temp_fields";
+    mkdir(directory.c_str(), 0755);
+    icp::DistanceField first(4, 20);
+    icp::DistanceField second(4, 20);
+    assert_true(!first.build_cached(points, directory));
+    assert_true(second.build_cached(points, directory));
+    assert_true(second.points() == points);
+    std::vector<std::string> files;
+    DIR* listing = opendir(directory.c_str());
+    while (struct dirent* entry = readdir(listing)) {
+        if (entry->d_name[0] != '.') {
+            files.push_back(directory + "/" + entry->d_name);
+        }
+    }
+    closedir(listing);
+    assert_equal(1, files.size());
+    corrupt_file(files[0], 100);
+    assert_true(!icp::DistanceField(4, 20).build_cached(points, directory));
+    assert_true(icp::DistanceField(4, 20).build_cached(points, directory));
+
+    // ICP instances share the cache, with the same results
+    sim::ScanPair pair = simulated_pair();
+    icp::ICP::Config config;
+    config.set("distance_field", 1);
+    std::unique_ptr<icp::ICP> built = icp::ICP::from_method("vanilla",
+        config);
+    config.set("field_cache", directory);
+    std::unique_ptr<icp::ICP> saving = icp::ICP::from_method("vanilla",
+        config);
+    std::unique_ptr<icp::ICP> loading = icp::ICP::from_method("vanilla",
+        config);
+    for (icp::ICP* icp: {built.get(), saving.get(), loading.get()}) {
+        icp->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+        icp->converge(BURN_IN, 0);
+        assert_true((icp->current_transform().translation
+                        - built->current_transform().translation)
+                        .norm()
+                    < 1e-12);
+    }
+
+    listing = opendir(directory.c_str());
+    while (struct dirent* entry = readdir(listing)) {
+        if (entry->d_name[0] != '.') {
+            remove((directory + "/" + entry->d_name).c_str());
+        }
+    }
+    closedir(listing);
+    rmdir(directory.c_str());
+}
+
+void test_features(void) {
+    // a square room reduces to its corners and a few beams of each wall
+    std::vector<icp::Vector> room;
+    for (int i = 0; i < 360; i++) {
+        double angle = i * M_PI / 180;
+        double range = 200 / std::max(fabs(cos(angle)), fabs(sin(angle)));
+        room.push_back(icp::Vector(range * cos(angle), range * sin(angle)));
+    }
+    const icp::Vector stray = room[100] *= 0.25;
+
+    icp::FeatureExtractor extractor;
+    std::vector<icp::Vector> features;
+    const size_t count = extractor.extract(room, features);
+    assert_equal(count, features.size());
+    assert_true(features.size() * 4 < room.size());
+    for (const icp::Vector& corner: {icp::Vector(200, 200),
+             icp::Vector(-200, 200), icp::Vector(-200, -200),
+             icp::Vector(200, -200)}) {
+        assert_true(std::any_of(features.begin(), features.end(),
+            [&](const icp::Vector& point) {
+                return (point - corner).norm() < 1e-6;
+            }));
+    }
+    assert_true(std::find(features.begin(), features.end(), stray)
+                == features.end());
+    size_t j = 0;
+    for (size_t i = 0; i < room.size() && j < features.size(); i++) {
+        j += room[i] == features[j];
+    }
+    assert_equal(features.size(), j);
+
+    // without any jump, the scan wraps around into a loop of four lines,
+    // so only the corners and beam samples are kept
+    room[100] *= 4;
+    extractor.extract(room, features);
+    for (size_t i = 0; i < room.size(); i++) {
+        const bool is_kept = std::find(features.begin(), features.end(),
+                                 room[i])
+                             != features.end();
+        const bool is_corner = i % 90 == 45;
+        assert_equal(is_corner || i % icp::FeatureParams().sample_stride == 0,
+            is_kept);
+    }
+
+    // aligning only the features of both scans converges as well as
+    // aligning every point
+    sim::ScanPair pair = simulated_pair();
+    std::vector<icp::Vector> source, destination;
+    extractor.extract(pair.source.points, source);
+    extractor.extract(pair.destination.points, destination);
+    assert_true(source.size() * 4 < pair.source.points.size());
+
+    std::unique_ptr<icp::ICP> full = icp::ICP::from_method("vanilla");
+    full->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    full->converge(BURN_IN, 0);
+    std::unique_ptr<icp::ICP> reduced = icp::ICP::from_method("vanilla");
+    reduced->begin(source, destination, icp::RBTransform());
+    reduced->converge(BURN_IN, 0);
+    const icp::RBTransform& result = reduced->current_transform();
+    assert_true((result.translation - pair.truth.translation).norm()
+                < (full->current_transform().translation
+                      - pair.truth.translation)
+                          .norm()
+                      + TRANS_EPS);
+    assert_true(fabs(atan2(result.rotation(1, 0), result.rotation(0, 0))
+                     - atan2(pair.truth.rotation(1, 0),
+                         pair.truth.rotation(0, 0)))
+                < RAD_EPS);
+}
+
+void test_spatial_order(void) {
+    // the curves visit every cell of a block at the origin before leaving
+    std::vector<bool> visited(256);
+    for (uint16_t x = 0; x < 16; x++) {
+        for (uint16_t y = 0; y < 16; y++) {
+            assert_true(hilbert_index(x, y) < 256);
+            assert_true(morton_index(x, y) < 256);
+            visited[hilbert_index(x, y)] = true;
+        }
+    }
+    assert_true(std::all_of(visited.begin(), visited.end(),
+        [](bool cell) { return cell; }));
+    assert_equal(39u, morton_index(3, 5));
+
+    // sorting changes nothing visible, and recorded matches still refer to
+    // the points in the order given
+    sim::ScanPair pair = simulated_pair();
+    std::vector<icp::Vector>& a = pair.source.points;
+    std::vector<icp::Vector>& b = pair.destination.points;
+    std::reverse(b.begin(), b.end());
+    const icp::Vector a_cm = icp::get_centroid(a);
+    const icp::Vector b_cm = icp::get_centroid(b);
+
+    std::unique_ptr<icp::ICP> plain = icp::ICP::from_method("trimmed");
+    plain->begin(a, b, icp::RBTransform());
+    plain->converge(BURN_IN, 0);
+    for (const char* order: {"morton", "hilbert"}) {
+        icp::ICP::Config config;
+        config.set("spatial_order", std::string(order));
+        std::unique_ptr<icp::ICP> sorted = icp::ICP::from_method("trimmed",
+            config);
+        icp::IterationTrace trace(true);
+        sorted->record(&trace);
+        sorted->begin(a, b, icp::RBTransform());
+        sorted->converge(BURN_IN, 0);
+        assert_true((sorted->current_transform().translation
+                        - plain->current_transform().translation)
+                        .norm()
+                    < 1e-6);
+
+        // the first iteration matched from the initial guess
+        for (size_t i = 0; i < a.size(); i++) {
+            double closest = INFINITY;
+            for (const icp::Vector& point: b) {
+                closest = std::min(closest,
+                    (point - b_cm - (a[i] - a_cm)).squaredNorm());
+            }
+            const icp::Vector& match = b[trace.pairs(0)[i]];
+            assert_true((match - b_cm - (a[i] - a_cm)).squaredNorm()
+                        <= closest + 1e-9);
+        }
+    }
+}
+
+void test_step(const std::string& method) {
+    sim::ScanPair pair = simulated_pair();
+    const size_t n = pair.source.points.size();
+    const size_t slice = 97;
+
+    for (int lazy = 0; lazy < 2; lazy++) {
+        icp::ICP::Config config;
+        config.set("lazy_matching", lazy);
+        std::unique_ptr<icp::ICP> whole = icp::ICP::from_method(method,
+            config);
+        std::unique_ptr<icp::ICP> sliced = icp::ICP::from_method(method,
+            config);
+        whole->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+        sliced->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+
+        // stepping through each iteration in slices changes nothing
+        for (int i = 0; i < 5; i++) {
+            whole->iterate();
+            size_t steps = 1;
+            while (!sliced->step(slice)) {
+                steps++;
+            }
+            assert_equal(method == "ndt" ? 1 : (n + slice - 1) / slice,
+                steps);
+            assert_true((whole->current_transform().translation
+                            - sliced->current_transform().translation)
+                            .norm()
+                        < 1e-9);
+            assert_true((whole->current_transform().rotation
+                            - sliced->current_transform().rotation)
+                            .norm()
+                        < 1e-9);
+            assert_equal(whole->calculate_cost(), sliced->calculate_cost());
+        }
+    }
+}
+
+void test_sampling(void) {
+    sim::ScanPair pair = simulated_pair(sim::pose(0.6, -0.4, 0.2));
+    const size_t n = pair.source.points.size();
+
+    std::unique_ptr<icp::ICP> whole = icp::ICP::from_method("vanilla");
+    whole->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport whole_report = whole->converge(BURN_IN, 20);
+
+    icp::ICP::Config config;
+    config.set("sample_fraction", 0.1);
+    std::unique_ptr<icp::ICP> sampled = icp::ICP::from_method("vanilla",
+        config);
+    icp::IterationTrace trace(true);
+    sampled->record(&trace);
+    sampled->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    icp::ICP::ConvergenceReport sampled_report = sampled->converge(BURN_IN,
+        20);
+
+    // the early iterations are cheaper yet end up just as good
+    assert_true(sampled_report.distance_evaluations
+                < whole_report.distance_evaluations);
+    assert_true(sampled_report.final_cost < whole_report.final_cost * 1.05);
+
+    // only the sample is matched at first, but every point by the end,
+    // each by its index in the cloud given
+    auto matched = [&](size_t frame) {
+        return n
+               - std::count(trace.pairs(frame), trace.pairs(frame) + n,
+                   icp::IterationTrace::no_pair);
+    };
+    assert_equal((size_t)std::ceil(0.1 * n), matched(0));
+    assert_equal(n, matched(trace.frame_count() - 1));
+    const uint32_t* pairs = trace.pairs(trace.frame_count() - 1);
+    assert_true(std::all_of(pairs, pairs + n, [&](uint32_t j) {
+        return j < pair.destination.points.size();
+    }));
+
+    // stopping early lists only the sample, as every point is back in place
+    for (const std::string method: {"vanilla", "trimmed"}) {
+        sampled = icp::ICP::from_method(method, config);
+        icp::ICP::Budget budget;
+        budget.max_iterations = 1;
+        sampled->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+        sampled->converge(BURN_IN, 0, budget);
+        std::vector<bool> seen(n);
+        for (icp::ICP::Correspondence pairing: sampled->correspondences()) {
+            assert_true(!seen[pairing.source]);
+            seen[pairing.source] = true;
+            assert_true(pairing.is_inlier);
+            assert_true(std::isfinite(pairing.residual));
+        }
+        assert_equal((size_t)std::ceil(0.1 * n),
+            sampled->correspondences().size());
+    }
+}
+
+void test_correspondences(void) {
+    sim::ScanPair pair = simulated_pair();
+    const size_t n = pair.source.points.size();
+
+    // sorting changes neither the correspondences nor how they are indexed
+    std::unique_ptr<icp::ICP> plain = icp::ICP::from_method("vanilla");
+    icp::ICP::Config config;
+    config.set("spatial_order", std::string("hilbert"));
+    std::unique_ptr<icp::ICP> sorted = icp::ICP::from_method("vanilla",
+        config);
+    std::vector<size_t> destination(n, SIZE_MAX);
+    std::vector<double> residual(n);
+    plain->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    plain->converge(BURN_IN, 0);
+    assert_equal(n, plain->correspondences().size());
+    for (icp::ICP::Correspondence pairing: plain->correspondences()) {
+        assert_true(pairing.is_inlier);
+        destination[pairing.source] = pairing.destination;
+        residual[pairing.source] = pairing.residual;
+    }
+    sorted->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    sorted->converge(BURN_IN, 0);
+    for (icp::ICP::Correspondence pairing: sorted->correspondences()) {
+        assert_equal(destination[pairing.source], pairing.destination);
+        assert_true(fabs(residual[pairing.source] - pairing.residual) < 1e-6);
+    }
+
+    // trimmed matches are inliers exactly when they are among the closest
+    config.set("overlap_rate", 0.8);
+    std::unique_ptr<icp::ICP> trimmed = icp::ICP::from_method("trimmed",
+        config);
+    trimmed->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform());
+    trimmed->converge(BURN_IN, 0);
+    size_t inliers = 0;
+    double worst_inlier = 0;
+    double best_outlier = INFINITY;
+    for (icp::ICP::Correspondence pairing: trimmed->correspondences()) {
+        inliers += pairing.is_inlier;
+        if (pairing.is_inlier) {
+            worst_inlier = std::max(worst_inlier, pairing.residual);
+        } else {
+            best_outlier = std::min(best_outlier, pairing.residual);
+        }
+    }
+    assert_equal((size_t)(0.8 * n), inliers);
+    assert_true(worst_inlier <= best_outlier);
+
+    // the covariance is symmetric with positive variances, and shrinks
+    // with more points
+    const Eigen::Matrix3d covariance = plain->covariance();
+    assert_true((covariance - covariance.transpose()).norm() < 1e-12);
+    assert_true((covariance.diagonal().array() > 0).all());
+    std::vector<icp::Vector> sparse_a, sparse_b;
+    for (size_t i = 0; i < n; i += 4) {
+        sparse_a.push_back(pair.source.points[i]);
+    }
+    for (size_t j = 0; j < pair.destination.points.size(); j += 4) {
+        sparse_b.push_back(pair.destination.points[j]);
+    }
+    plain->begin(sparse_a, sparse_b, icp::RBTransform());
+    plain->converge(BURN_IN, 0);
+    assert_true(plain->covariance().trace() > 2 * covariance.trace());
+
+    // too few points to estimate it
+    std::vector<icp::Vector> a = {icp::Vector(0, 0), icp::Vector(100, 100)};
+    plain->begin(a, a, icp::RBTransform());
+    plain->converge(BURN_IN, 0);
+    assert_true(std::isinf(plain->covariance()(0, 0)));
+}
+
+void test_memory_usage(void) {
+    sim::ScanPair pair = simulated_pair();
+    const size_t n = pair.source.points.size();
+
+    icp::ICP::Config config;
+    config.set("distance_field", 1);
+    for (const std::string method: {"vanilla", "trimmed", "ndt"}) {
+        std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method, config);
+        icp->begin(pair.source.points, pair.destination.points,
+            icp::RBTransform());
+        icp->converge(BURN_IN, 0);
+
+        // every buffer is counted, including the rotated source points
+        const icp::ICP::MemoryUsage usage = icp->memory_usage();
+        assert_true(usage.points
+                    >= (n + pair.destination.points.size())
+                           * sizeof(icp::Vector));
+        assert_true(usage.matches >= n * (sizeof(uint32_t) + sizeof(float)));
+        assert_equal(icp->matching_field()->memory_usage(),
+            usage.distance_field);
+        assert_true(usage.method >= n * sizeof(icp::Vector));
+        assert_equal(usage.points + usage.matches + usage.distance_field
+                         + usage.method,
+            usage.total());
+    }
+}
+
+void test_initial_guess(void) {
+    icp::InitialGuess guess;
+
+    // rotations too large for ICP alone are estimated closely enough to
+    // converge from
+    for (double angle: {2.0, M_PI, -1.5}) {
+        sim::ScanPair pair = simulated_pair(sim::pose(0.3, -0.2, angle));
+        const icp::RBTransform initial = guess.estimate(pair.source.points,
+            pair.destination.points);
+        const double truth = atan2(pair.truth.rotation(1, 0),
+            pair.truth.rotation(0, 0));
+        assert_true(fabs(remainder(atan2(initial.rotation(1, 0),
+                                       initial.rotation(0, 0))
+                                       - truth,
+                        2 * M_PI))
+                    < RAD_EPS);
+
+        std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("trimmed");
+        icp->begin(pair.source.points, pair.destination.points, initial);
+        icp->converge(BURN_IN, 0);
+        const icp::RBTransform& result = icp->current_transform();
+        assert_true(fabs(remainder(atan2(result.rotation(1, 0),
+                                       result.rotation(0, 0))
+                                       - truth,
+                        2 * M_PI))
+                    < RAD_EPS / 10);
+    }
+
+    // the rotations of the loop in test_icp are recovered exactly, even
+    // though half a turn more fits a symmetric cloud equally well
+    for (int deg = 0; deg < 20; deg++) {
+        std::vector<icp::Vector> a = {icp::Vector(0, 0), icp::Vector(100, 100)};
+        std::vector<icp::Vector> b = {};
+
+        double angle = (double)deg * M_PI / 180.0;
+        icp::Vector center(50, 50);
+        icp::Matrix rotation_matrix{
+            {cos(angle), -sin(angle)}, {sin(angle), cos(angle)}};
+        for (const auto& point: a) {
+            b.push_back(rotation_matrix * (point - center) + center);
+        }
+
+        const icp::RBTransform initial = guess.estimate(a, b);
+        assert_true((initial.rotation - rotation_matrix).norm() < 1e-6);
+        assert_true((initial.translation
+                        - (center - rotation_matrix * center))
+                        .norm()
+                    < 1e-3);
+    }
+
+    // rotations between bins are interpolated to within half a bin
+    const std::vector<icp::Vector> scan = simulated_pair().source.points;
+    for (int k = 1; k < 24; k++) {
+        const double angle = k * 7.3 * M_PI / 180;
+        icp::Matrix rotation{
+            {cos(angle), -sin(angle)}, {sin(angle), cos(angle)}};
+        std::vector<icp::Vector> rotated;
+        for (const icp::Vector& point: scan) {
+            rotated.push_back(rotation * point);
+        }
+        const icp::RBTransform initial = guess.estimate(scan, rotated);
+        assert_true(fabs(remainder(atan2(initial.rotation(1, 0),
+                                       initial.rotation(0, 0))
+                                       - angle,
+                        2 * M_PI))
+                    < 0.5 * M_PI / icp::InitialGuessParams().bins);
+    }
+
+    // without any surfaces, only the centroids are aligned
+    std::vector<icp::Vector> a = {icp::Vector(1, 2)};
+    std::vector<icp::Vector> b = {icp::Vector(4, 6)};
+    const icp::RBTransform initial = guess.estimate(a, b);
+    assert_true((initial.translation - icp::Vector(3, 4)).norm() < 1e-9);
+    assert_true((initial.rotation - icp::Matrix::Identity()).norm() < 1e-9);
+}
+
+void test_timeline(void) {
+    icp::Timeline::enable();
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method("vanilla");
+    std::vector<icp::Vector> a = {icp::Vector(0, 0), icp::Vector(0, 100)};
+    std::vector<icp::Vector> b = {icp::Vector(100, 0), icp::Vector(100, 100)};
+    icp->begin(a, b, icp::RBTransform());
+    icp->converge(BURN_IN, 0);
+
+    // spans from another thread are saved under a different id
+    std::thread([]() { icp::Timeline::Span span("other"); }).join();
+
+    const char* path = "_temp_timeline.json";
+    assert_true(icp::Timeline::save(path));
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    remove(path);
+    const std::string json = contents.str();
+    assert_equal(0, json.find("{\"traceEvents\":["));
+    for (const char* name: {"begin", "iterate", "match", "solve", "cost",
+             "decide"}) {
+        assert_true(json.find(std::string("\"name\":\"") + name + "\"")
+                    != std::string::npos);
+    }
+    auto tid_of = [&](const char* name) {
+        const size_t event = json.find(std::string("\"name\":\"") + name
+                                       + "\"");
+        assert_true(event != std::string::npos);
+        const size_t tid = json.find("\"tid\":", event);
+        return json.substr(tid, json.find(',', tid) - tid);
+    };
+    assert_true(tid_of("other") != tid_of("begin"));
+}
+
+void test_scan_log(void) {
+    const char* path = "_temp_log.icplog";
+    std::vector<std::vector<double>> scans;
+    icp::ScanLogWriter writer;
+    assert_true(writer.open(path));
+    for (size_t i = 0; i < 5; i++) {
+        const icp::ScanGeometry geometry{-M_PI + i, M_PI / 90, 0.15, 12};
+        std::vector<double> ranges;
+        for (size_t j = 0; j < 177 + i; j++) {
+            ranges.push_back(
+                j % 13 == 0 ? INFINITY : 0.15 + (j * i) % 1185 / 100.0);
+        }
+        scans.push_back(ranges);
+        assert_true(writer.add(i * 0.1, geometry, ranges.data(),
+            ranges.size()));
+    }
+    assert_true(writer.close());
+
+    // scans are read back in any order, exactly up to quantization
+    icp::ScanLog log;
+    assert_true(log.open(path));
+    assert_equal(scans.size(), log.size());
+    std::vector<float> ranges;
+    for (size_t i = scans.size(); i-- > 0;) {
+        const icp::ScanView scan = log.scan(i);
+        assert_equal(i * 0.1, scan.timestamp());
+        assert_equal(-M_PI + i, scan.geometry().angle_min);
+        assert_equal(M_PI / 90, scan.geometry().angle_increment);
+        assert_equal(scans[i].size(), scan.size());
+        scan.ranges(ranges);
+        for (size_t j = 0; j < scan.size(); j++) {
+            if (scans[i][j] == INFINITY) {
+                assert_equal(0, scan.quantized()[j]);
+                assert_equal(INFINITY, ranges[j]);
+            } else {
+                assert_true(
+                    fabs(scan.range(j) - scans[i][j]) <= 12 / 131068.0);
+                assert_true(fabs(ranges[j] - scans[i][j]) < 1e-3);
+            }
+        }
+    }
+    log.close();
+
+    // a truncated log is rejected
+    FILE* file = fopen(path, "r+b");
+    fseek(file, 0, SEEK_END);
+    assert_equal(0, ftruncate(fileno(file), ftell(file) - 8));
+    fclose(file);
+    assert_true(!log.open(path));
+    remove(path);
+}
+
+void test_no_allocation(const std::string& method) {
+    sim::ScanPair pair = simulated_pair(sim::pose(0.2, -0.1, 0.05),
+        5, 2 * M_PI / 500);
+    std::unique_ptr<icp::ICP> icp = icp::ICP::from_method(method);
+
+    // with a bounded point count, buffers are allocated on construction
+    size_t before = allocation_count;
+#ifdef ICP_MAX_POINTS
+    assert_true(icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform()));
+    icp->converge(BURN_IN, 0);
+    assert_equal(before, allocation_count);
+
+    std::vector<icp::Vector> too_many(icp::ICP::max_points + 1,
+        icp::Vector::Zero());
+    assert_true(!icp->begin(too_many, pair.destination.points,
+        icp::RBTransform()));
+    assert_true(!icp->begin(pair.source.points, too_many,
+        icp::RBTransform()));
+#endif
+
+    // otherwise, once sized by a first run, nothing is allocated again
+    assert_true(icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform()));
+    icp->converge(BURN_IN, 0);
+    before = allocation_count;
+    assert_true(icp->begin(pair.source.points, pair.destination.points,
+        icp::RBTransform()));
+    icp->converge(BURN_IN, 0);
+    assert_equal(before, allocation_count);
+}
+
+void test_tuner(void) {
+    sim::TuningSpace space;
+    space.methods = {"vanilla", "trimmed"};
+    space.burn_ins = {0};
+    space.convergence_thresholds = {0, 1000};
+    space.parameters = {{"overlap_rate", {0.8, 1}, false, {"trimmed"}}};
+    std::vector<sim::TuningCandidate> candidates = sim::Tuner::grid(space);
+    assert_equal(2 + 2 * 2, candidates.size());
+    assert_equal(4, sim::Tuner::random(space, 4, 1).size());
+    assert_equal(6, sim::Tuner::random(space, 100, 1).size());
+
+    sim::LidarParams params;
+    sim::LidarSimulator simulator(sim::World::room(10, 8, 5, 1), params, 1);
+    sim::Tuner tuner(sim::Tuner::random_pairs(simulator, 2, 0.2, 0.05, 1));
+    std::vector<sim::TuningResult> results = tuner.evaluate(candidates, 3);
+    assert_equal(candidates.size(), results.size());
+
+    // the front trades latency for error, and nothing beats it in both
+    std::vector<size_t> front = sim::Tuner::pareto_front(results);
+    assert_true(!front.empty());
+    for (size_t k = 1; k < front.size(); k++) {
+        assert_true(results[front[k]].latency >= results[front[k - 1]].latency);
+        assert_true(results[front[k]].error < results[front[k - 1]].error);
+    }
+    for (const sim::TuningResult& result: results) {
+        for (size_t i: front) {
+            assert_true(!(result.latency < results[i].latency
+                          && result.error < results[i].error));
+        }
+    }
+
+    // not stopping at a cost threshold is more accurate
+    size_t accurate = sim::Tuner::recommend(results, 0);
+    assert_equal(0, results[accurate].candidate.convergence_threshold);
+    size_t fastest = sim::Tuner::recommend(results, INFINITY);
+    assert_true(results[fastest].latency <= results[front[0]].latency);
+}
+
 void test_main() {
     test_kdtree();
+    test_multiselect();
+    test_adaptive_overlap();
+    test_simulator();
+    test_polar();
+    test_ndt();
+    test_anderson();
+    test_pipeline();
+    test_budget();
+    test_distance_field();
+    test_field_cache();
+    test_scan_log();
+    test_features();
+    test_spatial_order();
+    test_sampling();
+    test_correspondences();
+    test_memory_usage();
+    test_initial_guess();
+    test_tuner();
     for (const auto& method: icp::ICP::registered_methods()) {
         std::cout << "testing icp method: " << method << '\n';
         test_icp(method);
+        test_trace(method);
+        test_lazy_matching(method);
+        test_step(method);
+        test_no_allocation(method);
     }
+    test_timeline();
 }